@@ -0,0 +1,81 @@
+#include "async_writer.h"
+#include "text_format.h"
+
+AsyncWriter::AsyncWriter(std::ostream& file, const int columns, const size_t chunk_size):
+	file(file), columns(columns > 0 ? columns : throw 1), chunk_size(chunk_size > 0 ? chunk_size : throw 1),
+	back_ready(false), stopping(false), closed(false) {
+	front.reserve(chunk_size + columns);
+	back.reserve(chunk_size + columns);
+	worker = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+	try {
+		close();
+	}
+	catch (...) {
+	}
+}
+
+void AsyncWriter::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		ready.wait(lock, [this] { return back_ready || stopping; });
+		if (!back_ready) {
+			return;
+		}
+		lock.unlock();
+		TextFormat::write_rows(file, back, columns);
+		lock.lock();
+		back.clear();
+		back_ready = false;
+		drained.notify_one();
+	}
+}
+
+// Waits until the worker has written the previous chunk, then gives it the current one.
+void AsyncWriter::hand_over() {
+	std::unique_lock<std::mutex> lock(mutex);
+	drained.wait(lock, [this] { return !back_ready; });
+	std::swap(front, back);
+	back_ready = true;
+	ready.notify_one();
+}
+
+void AsyncWriter::push(const double x) {
+	front.push_back(x);
+	if (front.size() >= chunk_size && front.size() % columns == 0) {
+		hand_over();
+	}
+}
+
+void AsyncWriter::push(const double x, const double y) {
+	push(x);
+	push(y);
+}
+
+void AsyncWriter::push(std::span<const double> values) {
+	for (double x : values) {
+		push(x);
+	}
+}
+
+void AsyncWriter::close() {
+	if (closed) {
+		return;
+	}
+	closed = true;
+	if (!front.empty()) {
+		hand_over();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	ready.notify_one();
+	worker.join();
+	file.flush();
+	if (!file) {
+		throw 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Double-buffered text writer. Values are collected into the front buffer while
+// a background thread formats and writes the back one, so generating the next
+// chunk overlaps with the I/O of the previous one. Rows hold `columns` tab
+// separated values; nothing is flushed until close().
+class AsyncWriter {
+public:
+	AsyncWriter(std::ostream& file, const int columns = 2, const size_t chunk_size = 1 << 15);
+	AsyncWriter(const AsyncWriter&) = delete;
+	AsyncWriter& operator=(const AsyncWriter&) = delete;
+	~AsyncWriter();
+
+	void push(const double x);
+	void push(const double x, const double y);
+	void push(std::span<const double> values);
+	void close();
+private:
+	std::ostream& file;
+	int columns;
+	size_t chunk_size;
+	std::vector<double> front;
+	std::vector<double> back;
+	bool back_ready;
+	bool stopping;
+	bool closed;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable drained;
+	std::thread worker;
+
+	void hand_over();
+	void run();
+};
\ No newline at end of file
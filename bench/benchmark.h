@@ -0,0 +1,169 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+	std::string name;
+	double ns_per_op;
+	double mad_ns;
+	double ops_per_second;
+	int repetitions;
+	long long iterations;
+};
+
+// Times a callable with warmup, a calibrated number of iterations per
+// repetition and several repetitions, reporting the median time per
+// operation and its median absolute deviation.
+class Benchmark {
+public:
+	Benchmark(const int warmup = 2, const int repetitions = 11, const double min_time_ms = 20):
+		warmup(warmup), repetitions(repetitions > 0 ? repetitions : 1), min_time_ms(min_time_ms) {}
+
+	void set_filter(const std::string& filter) {
+		this->filter = filter;
+	}
+
+	void set_names(const std::vector<std::string>& names) {
+		this->names = names;
+	}
+
+	void set_repetitions(const int repetitions) {
+		this->repetitions = repetitions > 0 ? repetitions : 1;
+	}
+
+	// f performs ops_per_call operations and returns a value that is consumed so the work cannot be optimized away.
+	template<class F>
+	void run(const std::string& name, const long long ops_per_call, F&& f) {
+		if (!filter.empty() && name.find(filter) == std::string::npos) {
+			return;
+		}
+		if (!names.empty() && std::find(names.begin(), names.end(), name) == names.end()) {
+			return;
+		}
+		long long iterations = calibrate(f);
+		for (int i = 0; i < warmup; ++i) {
+			measure(f, iterations);
+		}
+		std::vector<double> samples;
+		for (int i = 0; i < repetitions; ++i) {
+			samples.push_back(measure(f, iterations) / (iterations * ops_per_call));
+		}
+		double median = median_of(samples);
+		for (double& x : samples) {
+			x = std::abs(x - median);
+		}
+		results.push_back({ name, median, median_of(samples), 1e9 / median, repetitions, iterations * ops_per_call });
+	}
+
+	const std::vector<BenchmarkResult>& get_results() const {
+		return results;
+	}
+
+	void write_table(std::ostream& out) const {
+		for (const auto& r : results) {
+			out << std::left << std::setw(48) << r.name << std::right << std::setw(14) << std::fixed << std::setprecision(2) << r.ns_per_op
+				<< " ns/op  +-" << std::setw(10) << r.mad_ns << std::setw(16) << std::setprecision(0) << r.ops_per_second << " op/s\n";
+		}
+	}
+
+	void write_json(std::ostream& out) const {
+		out << "{\n  \"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); ++i) {
+			const auto& r = results[i];
+			out << std::setprecision(17) << std::defaultfloat << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.ns_per_op << ", \"mad_ns\": " << r.mad_ns
+				<< ", \"ops_per_second\": " << r.ops_per_second << ", \"repetitions\": " << r.repetitions << ", \"iterations\": " << r.iterations << "}"
+				<< (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+	}
+
+	// Reads back the name, ns_per_op and mad_ns fields of a file written by write_json.
+	static std::vector<BenchmarkResult> read_json(std::istream& in) {
+		std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		std::vector<BenchmarkResult> baseline;
+		size_t position = 0;
+		while ((position = text.find("\"name\": \"", position)) != std::string::npos) {
+			position += 9;
+			size_t end = text.find('"', position);
+			BenchmarkResult r{ text.substr(position, end - position), field(text, "ns_per_op", end), field(text, "mad_ns", end), 0, 0, 0 };
+			r.ops_per_second = 1e9 / r.ns_per_op;
+			baseline.push_back(r);
+			position = end;
+		}
+		return baseline;
+	}
+
+	// A benchmark regresses when its median is more than `threshold` (relative) slower than the baseline
+	// and the difference also exceeds three times the larger of the two deviations, so noise alone does not fail the run.
+	int compare(const std::vector<BenchmarkResult>& baseline, const double threshold, std::ostream& report) const {
+		int regressions = 0;
+		for (const auto& r : results) {
+			auto old = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult& b) { return b.name == r.name; });
+			if (old == baseline.end()) {
+				report << std::left << std::setw(48) << r.name << " no baseline\n";
+				continue;
+			}
+			double change = r.ns_per_op / old->ns_per_op - 1;
+			bool regressed = change > threshold && r.ns_per_op - old->ns_per_op > 3 * std::max(r.mad_ns, old->mad_ns);
+			regressions += regressed;
+			report << std::left << std::setw(48) << r.name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << old->ns_per_op
+				<< " -> " << std::setw(12) << r.ns_per_op << " ns/op " << std::showpos << std::setw(8) << change * 100 << std::noshowpos << "%"
+				<< (regressed ? "  REGRESSION" : "") << "\n";
+		}
+		report << regressions << " regression(s) beyond " << threshold * 100 << "%\n";
+		return regressions;
+	}
+private:
+	int warmup;
+	int repetitions;
+	double min_time_ms;
+	std::string filter;
+	std::vector<std::string> names;
+	std::vector<BenchmarkResult> results;
+	volatile double sink = 0;
+
+	template<class F>
+	double measure(F& f, const long long iterations) {
+		auto start = std::chrono::steady_clock::now();
+		double consumed = 0;
+		for (long long i = 0; i < iterations; ++i) {
+			consumed += (double)f();
+		}
+		auto finish = std::chrono::steady_clock::now();
+		sink = sink + consumed;
+		return std::chrono::duration<double, std::nano>(finish - start).count();
+	}
+
+	template<class F>
+	long long calibrate(F& f) {
+		long long iterations = 1;
+		while (true) {
+			double ns = measure(f, iterations);
+			if (ns >= min_time_ms * 1e6 || iterations >= (1LL << 40)) {
+				return iterations;
+			}
+			iterations = ns < 1e3 ? iterations * 16 : (long long)std::ceil(iterations * std::min(16.0, 1.2 * min_time_ms * 1e6 / ns));
+		}
+	}
+
+	static double field(const std::string& text, const std::string& key, const size_t from) {
+		size_t position = text.find("\"" + key + "\": ", from);
+		if (position == std::string::npos) {
+			return 0;
+		}
+		return std::stod(text.substr(position + key.size() + 4, 32));
+	}
+
+	static double median_of(std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		size_t middle = values.size() / 2;
+		return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,179 @@
+// Micro-benchmarks of every IDistribution method. Build together with the
+// library sources (everything except main.cpp and distribution_test.cpp).
+// Usage: benchmark [--filter text] [--repetitions n] [--json file] [--core]
+//                  [--baseline file] [--threshold fraction] [--perf]
+//                  [--isa avx512|avx2|scalar]
+// --core runs only the kernels tracked for regressions. With --baseline the
+// results are compared against a file written earlier with --json, and the
+// exit code is non-zero when any benchmark regressed beyond the threshold
+// (default 0.1). --perf prints hardware counters per sample for the sampling
+// and batch density kernels instead of timing. --isa forces the vector math
+// kernels that would otherwise be chosen from CPUID.
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include "benchmark.h"
+#include "../laplace_distribution.h"
+#include "../empirical_distribution.h"
+#include "../mixture_distribution.cpp"
+#include "../perf_counters.h"
+#include "../vector_math.h"
+
+static void bench_distribution(Benchmark& bench, const std::string& name, const IDistribution& d) {
+	const int n = 10000;
+	auto selection = d.generate_selection(n);
+	double x = 0.3, p = 0.5;
+	bench.run(name + "/density", 1, [&] { x = x > 5 ? -5 : x + 0.01; return d.density(x); });
+	bench.run(name + "/rand_var", 1, [&] { return d.rand_var(); });
+	bench.run(name + "/generate_selection", n, [&] { return d.generate_selection(n).back(); });
+	bench.run(name + "/generate_graph_selection", n, [&] { return d.generate_graph_selection(selection).density.back(); });
+	bench.run(name + "/quantile", 1, [&] { p = p > 0.99 ? 0.01 : p + 0.001; return d.quantile(p); });
+	bench.run(name + "/generate_quasi_selection", n, [&] { SobolSequence sequence; return d.generate_quasi_selection(n, sequence).back(); });
+	bench.run(name + "/expected_value", 1, [&] { return d.expected_value(); });
+	bench.run(name + "/dispersion", 1, [&] { return d.dispersion(); });
+	bench.run(name + "/asymmetry", 1, [&] { return d.asymmetry(); });
+	bench.run(name + "/kurtosis", 1, [&] { return d.kurtosis(); });
+}
+
+// Runtime loops over n that LaplaceDistribution used before the fixed-form
+// kernels of laplace_kernel.h; they show what the specialization gains.
+static double runtime_fact(const double n) {
+	return n <= 1 ? 1 : n * runtime_fact(n - 1);
+}
+
+static double runtime_density(const double n, const double xstd) {
+	double dist_sum = 0;
+	for (int j = 0; j < n; ++j) {
+		dist_sum += (runtime_fact(n - 1 + j) * pow(std::abs(xstd), (n - j - 1))) / (runtime_fact(n - j - 1) * runtime_fact(j) * pow(2, j));
+	}
+	return exp(-std::abs(xstd)) * dist_sum / (runtime_fact(n - 1) * pow(2, n));
+}
+
+static double runtime_rand_var(const double n) {
+	double mult1 = 1, mult2 = 1;
+	for (int i = 0; i < n; ++i) {
+		double r;
+		do r = (double)rand() / RAND_MAX; while (r == 0 || r == 1);
+		if (r <= 0.5) {
+			mult1 *= 2 * r;
+		}
+		if (r > 0.5) {
+			mult2 *= 2 * (1 - r);
+		}
+	}
+	return log(mult1 / mult2);
+}
+
+static void bench_runtime_laplace(Benchmark& bench, const std::string& name, const double n) {
+	double x = 0.3;
+	bench.run(name + "/density_runtime", 1, [&] { x = x > 5 ? -5 : x + 0.01; return runtime_density(n, x); });
+	bench.run(name + "/rand_var_runtime", 1, [&] { return runtime_rand_var(n); });
+}
+
+static void perf_distribution(PerfCounters& counters, const std::string& name, const IDistribution& d) {
+	const int n = 1000000;
+	std::vector<double> selection;
+	auto print = [&](const std::string& kernel, const PerfReading& r) {
+		std::cout << std::left << std::setw(48) << name + "/" + kernel << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << r.cycles << " cycles" << std::setw(10) << r.instructions / r.cycles << " IPC"
+			<< std::setw(10) << r.cache_misses << " cache misses" << std::setw(10) << r.branch_misses << " branch misses  per sample\n";
+	};
+	print("generate_selection", counters.measure([&] { selection = d.generate_selection(n); }, n));
+	std::vector<double> density(n);
+	print("batch_density", counters.measure([&] { d.batch_density(selection, density); }, n));
+}
+
+int main(int argc, char** argv) {
+	srand((unsigned)time(0));
+	Benchmark bench;
+	std::string json;
+	std::string baseline;
+	double threshold = 0.1;
+	bool perf = false;
+	for (int i = 1; i < argc; ++i) {
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--core") == 0) {
+			bench.set_names({ "laplace/n=1/density", "laplace/n=4/density", "empirical/size=100000/k=100/rand_var",
+				"mixture/depth=2/rand_var", "mixture/depth=2/generate_selection" });
+		}
+		else if (strcmp(argv[i], "--perf") == 0) {
+			perf = true;
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+			bench.set_filter(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--repetitions") == 0 && has_value) {
+			bench.set_repetitions(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--json") == 0 && has_value) {
+			json = argv[++i];
+		}
+		else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+			baseline = argv[++i];
+		}
+		else if (strcmp(argv[i], "--threshold") == 0 && has_value) {
+			threshold = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--isa") == 0 && has_value) {
+			if (!VectorMath::set_instruction_set(argv[++i])) {
+				std::cerr << "Instruction set " << argv[i] << " is not available on this CPU" << std::endl;
+				return 2;
+			}
+		}
+	}
+
+	if (perf) {
+		PerfCounters counters;
+		if (!counters.is_available()) {
+			std::cerr << "Hardware counters are not available (perf_event_open failed or unsupported platform)" << std::endl;
+			return 2;
+		}
+		LaplaceDistribution ld(1, 0, 1);
+		LaplaceDistribution ld4(4, 0, 1);
+		LaplaceDistribution ld1(1, -2, 1), ld2(2, 2, 0.5);
+		MixtureDistribution<LaplaceDistribution, LaplaceDistribution> md(ld1, ld2, 0.5);
+		perf_distribution(counters, "laplace/n=1", ld);
+		perf_distribution(counters, "laplace/n=4", ld4);
+		perf_distribution(counters, "empirical/size=100000/k=100", EmpiricalDistribution(ld, 100000, 100));
+		perf_distribution(counters, "mixture/depth=1", md);
+		return 0;
+	}
+
+	for (int n : { 1, 2, 4, 8 }) {
+		bench_distribution(bench, "laplace/n=" + std::to_string(n), LaplaceDistribution(n, 0, 1));
+		bench_runtime_laplace(bench, "laplace/n=" + std::to_string(n), n);
+		LaplaceDistribution ziggurat(n, 0, 1);
+		ziggurat.set_sampler(LaplaceSampler::ziggurat);
+		bench.run("laplace/n=" + std::to_string(n) + "/rand_var_ziggurat", 1, [&] { return ziggurat.rand_var(); });
+		bench.run("laplace/n=" + std::to_string(n) + "/generate_selection_ziggurat", 10000, [&] { return ziggurat.generate_selection(10000).back(); });
+	}
+
+	LaplaceDistribution ld;
+	for (int size : { 1000, 100000 }) {
+		for (int k : { 3, 100 }) {
+			bench_distribution(bench, "empirical/size=" + std::to_string(size) + "/k=" + std::to_string(k), EmpiricalDistribution(ld, size, k));
+		}
+	}
+
+	LaplaceDistribution ld1(1, -2, 1), ld2(2, 2, 0.5), ld3(1, 0, 2), ld4(3, 4, 1);
+	MixtureDistribution<LaplaceDistribution, LaplaceDistribution> md1(ld1, ld2, 0.5);
+	MixtureDistribution<LaplaceDistribution, LaplaceDistribution> md2(ld3, ld4, 0.3);
+	MixtureDistribution<MixtureDistribution<LaplaceDistribution, LaplaceDistribution>, MixtureDistribution<LaplaceDistribution, LaplaceDistribution>> md(md1, md2, 0.5);
+	bench_distribution(bench, "mixture/depth=1", md1);
+	bench_distribution(bench, "mixture/depth=2", md);
+
+	bench.write_table(std::cout);
+	if (!json.empty()) {
+		std::ofstream file(json);
+		bench.write_json(file);
+	}
+	if (!baseline.empty()) {
+		std::ifstream file(baseline);
+		if (!file.is_open()) {
+			std::cerr << "No baseline " << baseline << ", create one with --json" << std::endl;
+			return 2;
+		}
+		return bench.compare(Benchmark::read_json(file), threshold, std::cout) > 0 ? 1 : 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+enum class DistributionTag : uint8_t { laplace = 1, empirical = 2, mixture = 3, flat_mixture = 4, sample_store = 5 };
+
+// Versioned binary layout shared by the IPresistend implementations:
+// a 4-byte magic, a 16-bit version and an 8-bit type tag, then the payload.
+// Every number is stored little-endian, doubles bit-exact. Version 2 added
+// the flags word of the empirical payload; version 1 files are still read.
+class BinaryFormat {
+public:
+	static const uint16_t version = 2;
+	static const uint16_t oldest_version = 1;
+	static const size_t header_size = 8;
+
+	static void write_header(std::ostream& file, DistributionTag tag) {
+		file.write(magic, sizeof(magic));
+		write_integer(file, version, 2);
+		write_integer(file, (uint8_t)tag, 1);
+		write_integer(file, 0, 1);
+	}
+
+	static DistributionTag read_header(std::istream& file, uint16_t& file_version) {
+		char buffer[sizeof(magic)];
+		file.read(buffer, sizeof(buffer));
+		if (!file || memcmp(buffer, magic, sizeof(magic)) != 0) {
+			throw 0;
+		}
+		file_version = (uint16_t)read_integer(file, 2);
+		if (file_version < oldest_version || file_version > version) {
+			throw 0;
+		}
+		DistributionTag tag = (DistributionTag)read_integer(file, 1);
+		read_integer(file, 1);
+		return tag;
+	}
+
+	static DistributionTag read_header(std::istream& file) {
+		uint16_t file_version;
+		return read_header(file, file_version);
+	}
+
+	// Returns the version of the payload that follows.
+	static uint16_t expect_header(std::istream& file, DistributionTag tag) {
+		uint16_t file_version;
+		if (read_header(file, file_version) != tag) {
+			throw 0;
+		}
+		return file_version;
+	}
+
+	static void write_integer(std::ostream& file, uint64_t value, int bytes) {
+		char buffer[8];
+		for (int i = 0; i < bytes; ++i) {
+			buffer[i] = (char)(value >> (8 * i));
+		}
+		file.write(buffer, bytes);
+	}
+
+	static uint64_t read_integer(std::istream& file, int bytes) {
+		unsigned char buffer[8];
+		file.read((char*)buffer, bytes);
+		if (!file) {
+			throw 0;
+		}
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; ++i) {
+			value |= (uint64_t)buffer[i] << (8 * i);
+		}
+		return value;
+	}
+
+	// Bytes between the read position and the end of the stream; unbounded when the stream cannot seek.
+	static uint64_t bytes_left(std::istream& file) {
+		const std::streampos position = file.tellg();
+		if (position == std::streampos(-1)) {
+			return UINT64_MAX;
+		}
+		file.seekg(0, std::ios::end);
+		const std::streampos end = file.tellg();
+		file.clear();
+		file.seekg(position);
+		return end == std::streampos(-1) || end < position ? UINT64_MAX : (uint64_t)(end - position);
+	}
+
+	static void write_double(std::ostream& file, double x) {
+		write_doubles(file, &x, 1);
+	}
+
+	static double read_double(std::istream& file) {
+		double x;
+		read_doubles(file, &x, 1);
+		return x;
+	}
+
+	static void write_doubles(std::ostream& file, const double* data, size_t count) {
+		if constexpr (std::endian::native == std::endian::little) {
+			file.write((const char*)data, count * sizeof(double));
+		}
+		else {
+			for (size_t i = 0; i < count; ++i) {
+				write_integer(file, std::bit_cast<uint64_t>(data[i]), 8);
+			}
+		}
+	}
+
+	static void read_doubles(std::istream& file, double* data, size_t count) {
+		if constexpr (std::endian::native == std::endian::little) {
+			file.read((char*)data, count * sizeof(double));
+			if (!file) {
+				throw 0;
+			}
+		}
+		else {
+			for (size_t i = 0; i < count; ++i) {
+				data[i] = std::bit_cast<double>(read_integer(file, 8));
+			}
+		}
+	}
+private:
+	static constexpr char magic[4] = { 'D', 'M', 'B', 'F' };
+};
\ No newline at end of file
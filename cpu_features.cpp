@@ -0,0 +1,81 @@
+#include "cpu_features.h"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define CPU_FEATURES_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_FEATURES_X86
+#endif
+#include <cstdint>
+
+namespace {
+#ifdef CPU_FEATURES_X86
+	void cpuid(const unsigned leaf, const unsigned subleaf, unsigned registers[4]) {
+#ifdef _MSC_VER
+		int result[4];
+		__cpuidex(result, (int)leaf, (int)subleaf);
+		for (int i = 0; i < 4; ++i) {
+			registers[i] = (unsigned)result[i];
+		}
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	uint64_t xgetbv() {
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return ((uint64_t)high << 32) | low;
+#endif
+	}
+#endif
+}
+
+CpuFeatures::Flags CpuFeatures::detect() {
+	Flags result = { false, false, false };
+#ifdef CPU_FEATURES_X86
+	unsigned registers[4];
+	cpuid(0, 0, registers);
+	const unsigned max_leaf = registers[0];
+	if (max_leaf < 7) {
+		return result;
+	}
+	cpuid(1, 0, registers);
+	const bool osxsave = registers[2] & (1u << 27);
+	const bool avx = registers[2] & (1u << 28);
+	const bool fma = registers[2] & (1u << 12);
+	if (!osxsave || !avx) {
+		return result;
+	}
+	const uint64_t xcr0 = xgetbv();
+	// SSE and AVX state for 256-bit registers; opmask and both ZMM halves for AVX-512.
+	const bool ymm_state = (xcr0 & 0x6) == 0x6;
+	const bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+	cpuid(7, 0, registers);
+	result.avx2 = ymm_state && (registers[1] & (1u << 5));
+	result.fma = ymm_state && fma;
+	result.avx512f = zmm_state && (registers[1] & (1u << 16));
+#endif
+	return result;
+}
+
+const CpuFeatures::Flags& CpuFeatures::flags() {
+	static const Flags instance = detect();
+	return instance;
+}
+
+bool CpuFeatures::avx2() {
+	return flags().avx2;
+}
+
+bool CpuFeatures::fma() {
+	return flags().fma;
+}
+
+bool CpuFeatures::avx512f() {
+	return flags().avx512f;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+// x86 instruction set extensions usable by this process, read once through
+// CPUID. An extension counts only when the operating system also saves the
+// register state it needs (XGETBV), so AVX-512 is reported as missing on
+// systems that disable it. Everything is false on other architectures.
+class CpuFeatures {
+public:
+	static bool avx2();
+	static bool fma();
+	static bool avx512f();
+private:
+	struct Flags {
+		bool avx2;
+		bool fma;
+		bool avx512f;
+	};
+
+	static const Flags& flags();
+	static Flags detect();
+};
\ No newline at end of file
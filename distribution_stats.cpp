@@ -0,0 +1,199 @@
+#include "distribution_stats.h"
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+	struct Entry {
+		std::string name;
+		const void* parent;
+		std::unique_ptr<DistributionStats::Counters> counters;
+	};
+
+	typedef std::map<const void*, Entry> Table;
+
+	struct Summary {
+		std::string name;
+		const void* parent;
+		uint64_t calls[DistributionStats::events_number];
+		uint64_t nanoseconds[DistributionStats::events_number];
+		uint64_t histogram[DistributionStats::events_number][DistributionStats::buckets_number];
+	};
+
+	void merge(std::map<const void*, Summary>& into, const Table& table) {
+		for (const auto& item : table) {
+			Summary& summary = into[item.first];
+			if (summary.name.empty()) {
+				summary.name = item.second.name;
+				summary.parent = item.second.parent;
+			}
+			for (int e = 0; e < DistributionStats::events_number; ++e) {
+				summary.calls[e] += item.second.counters->calls[e].load(std::memory_order_relaxed);
+				summary.nanoseconds[e] += item.second.counters->nanoseconds[e].load(std::memory_order_relaxed);
+				for (int b = 0; b < DistributionStats::buckets_number; ++b) {
+					summary.histogram[e][b] += item.second.counters->histogram[e][b].load(std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+	struct ThreadTable;
+
+	struct Registry {
+		std::mutex mutex;
+		std::vector<ThreadTable*> threads;
+		std::map<const void*, Summary> retired;
+	};
+
+	Registry& registry() {
+		static Registry instance;
+		return instance;
+	}
+
+	// Only the owning thread inserts into its table, so it looks entries up without the lock, which guards
+	// the insertions against concurrent dump() and reset() calls. The last instance found is cached.
+	struct ThreadTable {
+		std::mutex mutex;
+		Table table;
+		const void* current = nullptr;
+		const void* cached_instance = nullptr;
+		DistributionStats::Counters* cached_counters = nullptr;
+
+		ThreadTable() {
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			registry().threads.push_back(this);
+		}
+
+		~ThreadTable() {
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			merge(registry().retired, table);
+			auto& threads = registry().threads;
+			threads.erase(std::find(threads.begin(), threads.end(), this));
+		}
+	};
+
+	ThreadTable& thread_table() {
+		thread_local ThreadTable table;
+		return table;
+	}
+
+	int bucket(const uint64_t nanoseconds) {
+		return std::min(std::max((int)std::bit_width(nanoseconds) - 1, 0), DistributionStats::buckets_number - 1);
+	}
+
+	// Counters are written by their owning thread only, so a plain load and store replaces the locked read-modify-write.
+	void add(std::atomic<uint64_t>& counter, const uint64_t value) {
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void clear(DistributionStats::Counters& counters) {
+		for (int e = 0; e < DistributionStats::events_number; ++e) {
+			counters.calls[e].store(0, std::memory_order_relaxed);
+			counters.nanoseconds[e].store(0, std::memory_order_relaxed);
+			for (int b = 0; b < DistributionStats::buckets_number; ++b) {
+				counters.histogram[e][b].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Upper bound of the bucket holding the given fraction of the calls.
+	uint64_t percentile(const uint64_t* histogram, const uint64_t calls, const double fraction) {
+		uint64_t seen = 0;
+		for (int b = 0; b < DistributionStats::buckets_number; ++b) {
+			seen += histogram[b];
+			if (seen >= fraction * calls) {
+				return 2ull << b;
+			}
+		}
+		return 0;
+	}
+}
+
+DistributionStats::Counters& DistributionStats::find(const void* instance, const char* name) {
+	ThreadTable& thread = thread_table();
+	if (thread.cached_instance == instance) {
+		return *thread.cached_counters;
+	}
+	auto found = thread.table.find(instance);
+	if (found == thread.table.end()) {
+		std::lock_guard<std::mutex> lock(thread.mutex);
+		Entry entry{ name, thread.current, std::make_unique<Counters>() };
+		found = thread.table.emplace(instance, std::move(entry)).first;
+	}
+	thread.cached_instance = instance;
+	thread.cached_counters = found->second.counters.get();
+	return *thread.cached_counters;
+}
+
+DistributionStats::Scope::Scope(const void* instance, const char* name, const Event event):
+	counters(&find(instance, name)), event(event), previous(thread_table().current), start(std::chrono::steady_clock::now()) {
+	thread_table().current = instance;
+}
+
+DistributionStats::Scope::~Scope() {
+	uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	add(counters->calls[event], 1);
+	add(counters->nanoseconds[event], elapsed);
+	add(counters->histogram[event][bucket(elapsed)], 1);
+	thread_table().current = previous;
+}
+
+void DistributionStats::count(const void* instance, const char* name, const Event event) {
+	add(find(instance, name).calls[event], 1);
+}
+
+const char* DistributionStats::event_name(const Event event) {
+	static const char* names[] = { "density", "batch_density", "rand_var", "generate_selection", "moments", "distribution_function", "quantile", "rng_draw" };
+	return names[event];
+}
+
+void DistributionStats::dump(std::ostream& out) {
+	std::map<const void*, Summary> total;
+	{
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		for (const auto& item : registry().retired) {
+			total[item.first] = item.second;
+		}
+		for (ThreadTable* thread : registry().threads) {
+			std::lock_guard<std::mutex> table_lock(thread->mutex);
+			merge(total, thread->table);
+		}
+	}
+	for (const auto& item : total) {
+		const Summary& s = item.second;
+		out << s.name << " " << item.first;
+		auto parent = total.find(s.parent);
+		if (parent != total.end()) {
+			out << " (inside " << parent->second.name << " " << s.parent << ")";
+		}
+		out << "\n";
+		for (int e = 0; e < events_number; ++e) {
+			if (s.calls[e] == 0) {
+				continue;
+			}
+			out << "  " << std::left << std::setw(20) << event_name((Event)e) << std::right << std::setw(14) << s.calls[e] << " calls";
+			if (s.nanoseconds[e] > 0) {
+				out << std::setw(12) << s.nanoseconds[e] / s.calls[e] << " ns mean  p50 < " << percentile(s.histogram[e], s.calls[e], 0.5)
+					<< " ns  p99 < " << percentile(s.histogram[e], s.calls[e], 0.99) << " ns";
+			}
+			out << "\n";
+		}
+	}
+}
+
+// A call finishing on another thread at the same moment may write its old count back over the reset.
+void DistributionStats::reset() {
+	std::lock_guard<std::mutex> lock(registry().mutex);
+	registry().retired.clear();
+	for (ThreadTable* thread : registry().threads) {
+		std::lock_guard<std::mutex> table_lock(thread->mutex);
+		for (auto& item : thread->table) {
+			clear(*item.second.counters);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Call counters and log2-bucketed latency histograms per distribution instance,
+// compiled in only with DISTRIBUTION_STATS defined. Every thread records into
+// its own table; dump() merges the tables of all threads, including finished
+// ones. A scope entered while another distribution's scope is active on the
+// same thread records that distribution as its parent, which attributes the
+// cost of nested MixtureDistribution trees to their components. Instances are
+// identified by address: a distribution created where a destroyed one lived
+// continues its counters.
+class DistributionStats {
+public:
+	enum Event { density, batch_density, rand_var, generate_selection, moments, distribution_function, quantile, rng_draw, events_number };
+
+	static const int buckets_number = 40;
+
+	struct Counters {
+		std::atomic<uint64_t> calls[events_number];
+		std::atomic<uint64_t> nanoseconds[events_number];
+		std::atomic<uint64_t> histogram[events_number][buckets_number];
+	};
+
+	class Scope {
+	public:
+		Scope(const void* instance, const char* name, const Event event);
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope();
+	private:
+		Counters* counters;
+		Event event;
+		const void* previous;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	static void count(const void* instance, const char* name, const Event event);
+	static void dump(std::ostream& out);
+	static void reset();
+
+	static const char* event_name(const Event event);
+private:
+	static Counters& find(const void* instance, const char* name);
+};
+
+#ifdef DISTRIBUTION_STATS
+#define DISTRIBUTION_SCOPE(name, event) DistributionStats::Scope distribution_scope(this, name, DistributionStats::event)
+#define DISTRIBUTION_COUNT(name, event) DistributionStats::count(this, name, DistributionStats::event)
+#else
+#define DISTRIBUTION_SCOPE(name, event)
+#define DISTRIBUTION_COUNT(name, event)
+#endif
\ No newline at end of file
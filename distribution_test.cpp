@@ -2,6 +2,21 @@
 #include "laplace_distribution.h"
 #include "mixture_distribution.cpp"
 #include "empirical_distribution.h"
+#include "text_format.h"
+#include "binary_format.h"
+#include "flat_mixture_distribution.h"
+#include "sample_store.h"
+#include "async_writer.h"
+#include "perf_counters.h"
+#include "tracing.h"
+#include "factorial_table.h"
+#include "ziggurat.h"
+#include "vector_math.h"
+#include "cpu_features.h"
+#include "sobol_sequence.h"
+#include <climits>
+#include <sstream>
+#include <thread>
 
 bool equal(const double& x, const double& y) {
     if (abs(x - y) <= 0.1) {
@@ -98,4 +113,696 @@ TEST_CASE("empirical distribution") {
     CHECK(ed.get_size() == 200);
     CHECK(ed.get_intrevals_number() == 8);
     CHECK(equal(ed.expected_value(), 0.0) == true);
+}
+
+TEST_CASE("laplace parameters fit") {
+    LaplaceDistribution distr(1, 2, 1.5);
+    auto selection = distr.generate_selection(50000);
+    LaplaceDistribution fitted = LaplaceDistribution::fit(selection);
+    CHECK(fitted.get_form() == 1);
+    CHECK(equal(fitted.get_shift(), 2) == true);
+    CHECK(equal(fitted.get_scale(), 1.5) == true);
+}
+
+TEST_CASE("empirical kernel density") {
+    LaplaceDistribution distr1;
+    EmpiricalDistribution ed(distr1, 20000, 1);
+    ed.set_kernel_density(Kernel::gaussian);
+    CHECK(equal(ed.density(0), 0.5) == true);
+    CHECK(equal(ed.density(2), 0.068) == true);
+    double integral = 0;
+    for (double x : ed.get_kernel_density()->get_grid()) {
+        integral += x * ed.get_kernel_density()->get_grid_step();
+    }
+    CHECK(equal(integral, 1.0) == true);
+    ed.set_kernel_density(Kernel::epanechnikov, Bandwidth::scott);
+    CHECK(equal(ed.density(0), 0.5) == true);
+    ed.set_histogram_density();
+    CHECK(!ed.get_kernel_density());
+}
+
+TEST_CASE("empirical rebinning") {
+    EmpiricalDistribution ed(std::vector<double>{0, 1, 1, 2, 3, 3, 3, 4});
+    ed.set_intrevals_number(4);
+    auto density = ed.get_empirical_density();
+    REQUIRE(density.size() == 4);
+    CHECK(density[0] == 1.0 / 8);
+    CHECK(density[1] == 2.0 / 8);
+    CHECK(density[2] == 1.0 / 8);
+    CHECK(density[3] == 4.0 / 8);
+    ed.set_intrevals_number(2);
+    density = ed.get_empirical_density();
+    REQUIRE(density.size() == 2);
+    CHECK(density[0] == 3.0 / 16);
+    CHECK(density[1] == 5.0 / 16);
+}
+
+TEST_CASE("empirical distribution move semantics") {
+    std::vector<double> sample{0, 1, 1, 2, 3, 3, 3, 4};
+    const double* buffer = sample.data();
+    EmpiricalDistribution ed(std::move(sample));
+    CHECK(ed.get_selection().data() == buffer);
+    EmpiricalDistribution moved(std::move(ed));
+    CHECK(moved.get_selection().data() == buffer);
+    CHECK(moved.get_size() == 8);
+    CHECK(ed.get_size() == 0);
+    EmpiricalDistribution copy(moved);
+    CHECK(copy.get_selection().data() != buffer);
+    CHECK(copy.get_empirical_density().size() == moved.get_empirical_density().size());
+}
+
+TEST_CASE("empirical distribution unsorted input") {
+    std::vector<double> sample{3, 1, 4, 0, 3, 1, 3, 2};
+    EmpiricalDistribution sorted(sample);
+    CHECK(sorted.is_ordered() == true);
+    CHECK(sorted.get_selection()[0] == 0);
+    CHECK(sorted.get_selection()[7] == 4);
+    EmpiricalDistribution unordered(sample, false);
+    CHECK(unordered.is_ordered() == false);
+    CHECK(unordered.get_selection()[0] == 3);
+    unordered.set_intrevals_number(4);
+    sorted.set_intrevals_number(4);
+    for (int i = 0; i < 4; ++i) {
+        CHECK(unordered.get_empirical_density()[i] == sorted.get_empirical_density()[i]);
+    }
+}
+
+TEST_CASE("binary persistence round trip") {
+    LaplaceDistribution distr1(2, 0.1, 1.0 / 3);
+    LaplaceDistribution distr2(1, -1.7, 0.3);
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mdistr(distr1, distr2, 0.3);
+    EmpiricalDistribution ed(distr1, 1000, 12);
+    std::ofstream out("binary_test.bin", std::ios::binary);
+    mdistr.save_in_binary(out);
+    ed.save_in_binary(out);
+    out.close();
+
+    LaplaceDistribution loaded1, loaded2;
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mloaded(loaded1, loaded2, 0.5);
+    EmpiricalDistribution eloaded(std::vector<double>{0, 1});
+    std::ifstream in("binary_test.bin", std::ios::binary);
+    mloaded.load_from_binary(in);
+    eloaded.load_from_binary(in);
+    in.close();
+    std::remove("binary_test.bin");
+
+    CHECK(mloaded.get_p() == 0.3);
+    CHECK(mloaded.component1().get_form() == 2);
+    CHECK(mloaded.component1().get_shift() == 0.1);
+    CHECK(mloaded.component1().get_scale() == 1.0 / 3);
+    CHECK(mloaded.component2().get_shift() == -1.7);
+    CHECK(mloaded.component2().get_scale() == 0.3);
+    CHECK(eloaded.get_size() == 1000);
+    CHECK(eloaded.get_intrevals_number() == 12);
+    CHECK(std::equal(eloaded.get_selection().begin(), eloaded.get_selection().end(), ed.get_selection().begin()) == true);
+
+    std::ostringstream truncated;
+    BinaryFormat::write_header(truncated, DistributionTag::empirical);
+    BinaryFormat::write_integer(truncated, 12, 4);
+    BinaryFormat::write_integer(truncated, 0, 4);
+    BinaryFormat::write_integer(truncated, INT_MAX, 8);
+    BinaryFormat::write_double(truncated, 1);
+    std::istringstream truncated_stream(truncated.str());
+    CHECK_THROWS_AS(eloaded.load_from_binary(truncated_stream), int);
+    CHECK(eloaded.get_size() == 1000);
+    truncated_stream.clear();
+    truncated_stream.seekg(0);
+    CHECK_THROWS_AS(FlatMixtureDistribution::load_from_binary(truncated_stream), int);
+
+    std::vector<double> sample = { -1.5, -0.25, 0, 0.5, 2, 3.75 };
+    for (int k : { INT_MAX, 7, 2 }) {
+        std::ostringstream payload;
+        BinaryFormat::write_header(payload, DistributionTag::empirical);
+        BinaryFormat::write_integer(payload, k, 4);
+        BinaryFormat::write_integer(payload, 0, 4);
+        BinaryFormat::write_integer(payload, sample.size(), 8);
+        BinaryFormat::write_doubles(payload, sample.data(), sample.size());
+        std::istringstream stream(payload.str());
+        if (k > (int)sample.size()) {
+            CHECK_THROWS_AS(eloaded.load_from_binary(stream), int);
+        }
+        else {
+            eloaded.load_from_binary(stream);
+            CHECK(eloaded.get_intrevals_number() == 3);
+        }
+    }
+}
+
+TEST_CASE("empirical distribution mapped from binary file") {
+    LaplaceDistribution distr1;
+    EmpiricalDistribution ed(distr1, 1000, 10);
+    std::ofstream out("mapped_test.bin", std::ios::binary);
+    ed.save_in_binary(out);
+    out.close();
+    {
+        EmpiricalDistribution mapped = EmpiricalDistribution::map_binary("mapped_test.bin");
+        CHECK(mapped.is_mapped() == true);
+        CHECK(mapped.is_ordered() == true);
+        CHECK(mapped.get_size() == 1000);
+        CHECK(mapped.get_intrevals_number() == 10);
+        CHECK(std::equal(mapped.get_selection().begin(), mapped.get_selection().end(), ed.get_selection().begin()) == true);
+        EmpiricalDistribution copy(mapped);
+        CHECK(copy.get_selection().data() == mapped.get_selection().data());
+        CHECK(copy.density(0) == ed.density(0));
+        CHECK(copy.expected_value() == ed.expected_value());
+    }
+    std::remove("mapped_test.bin");
+}
+
+TEST_CASE("text format round trip") {
+    LaplaceDistribution distr1(1, 0, 1e-3);
+    auto values = distr1.generate_selection(20000);
+    values.push_back(1e300);
+    values.push_back(-0.1);
+    std::stringstream stream;
+    TextFormat::write_doubles(stream, values);
+    auto parsed = TextFormat::read_doubles(stream);
+    CHECK(parsed == values);
+    std::stringstream bad("1.5 2.5x 3");
+    CHECK_THROWS(TextFormat::read_doubles(bad));
+}
+
+TEST_CASE("persistence through streams and paths") {
+    LaplaceDistribution distr1(1, 0.1, 0.7);
+    LaplaceDistribution distr2(3, -2, 1.3);
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mdistr(distr1, distr2, 0.25);
+    std::stringstream stream;
+    mdistr.save_in_file(stream);
+    LaplaceDistribution loaded1, loaded2;
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mloaded(loaded1, loaded2, 0.5);
+    mloaded.load_from_file(stream);
+    CHECK(mloaded.get_p() == 0.25);
+    CHECK(mloaded.component1().get_scale() == 0.7);
+    CHECK(mloaded.component2().get_form() == 3);
+
+    EmpiricalDistribution ed(distr2, 500, 1);
+    ed.save_in_path("path_test.txt");
+    EmpiricalDistribution eloaded(std::vector<double>{0, 1});
+    eloaded.load_from_path("path_test.txt");
+    std::remove("path_test.txt");
+    CHECK(std::equal(eloaded.get_selection().begin(), eloaded.get_selection().end(), ed.get_selection().begin()) == true);
+    CHECK_THROWS(eloaded.load_from_path("missing_file.txt"));
+}
+
+TEST_CASE("mixture tree loaded into flat mixture") {
+    LaplaceDistribution distr1(1, -2, 1);
+    LaplaceDistribution distr2(2, 2, 0.5);
+    EmpiricalDistribution ed(distr1, 1000, 1);
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mdistr(distr1, distr2, 0.25);
+    MixtureDistribution<MixtureDistribution<LaplaceDistribution, LaplaceDistribution>, EmpiricalDistribution> tree(mdistr, ed, 0.5);
+    std::stringstream stream;
+    tree.save_in_binary(stream);
+    FlatMixtureDistribution flat = FlatMixtureDistribution::load_from_binary(stream);
+    REQUIRE(flat.get_components_number() == 3);
+    CHECK(flat.get_weight(0) == 0.375);
+    CHECK(flat.get_weight(1) == 0.125);
+    CHECK(flat.get_weight(2) == 0.5);
+    CHECK(equal(flat.density(0.3), tree.density(0.3)) == true);
+    CHECK(equal(flat.expected_value(), tree.expected_value()) == true);
+    CHECK(equal(flat.dispersion(), tree.dispersion()) == true);
+
+    std::stringstream flat_stream;
+    flat.save_in_binary(flat_stream);
+    FlatMixtureDistribution reloaded = FlatMixtureDistribution::load_from_binary(flat_stream);
+    CHECK(reloaded.get_components_number() == 3);
+    CHECK(reloaded.density(0.3) == flat.density(0.3));
+}
+
+TEST_CASE("chunked sample store") {
+    LaplaceDistribution distr1(1, 1, 2);
+    auto sample = distr1.generate_selection(5000);
+    sample.push_back(-0.0);
+    SampleStore::write("store_test.bin", sample, SampleCodec::delta_bitpack, 1000);
+    {
+        SampleStore store("store_test.bin");
+        EmpiricalDistribution ed(sample);
+        CHECK(store.get_size() == 5001);
+        CHECK(store.get_chunks_number() == 6);
+        CHECK(equal(store.expected_value(), ed.expected_value()) == true);
+        CHECK(equal(store.dispersion(), ed.dispersion()) == true);
+        CHECK(equal(store.kurtosis(), ed.kurtosis()) == true);
+        CHECK(store.get_min() == sample.front());
+        CHECK(store.read_all() == sample);
+        auto middle = store.read(1500, 1000);
+        CHECK(std::equal(middle.begin(), middle.end(), sample.begin() + 1500) == true);
+        EmpiricalDistribution positive(store, 0);
+        CHECK(positive.get_selection()[0] >= 0);
+        CHECK(positive.expected_value() > 0);
+        EmpiricalDistribution full(store);
+        CHECK(full.expected_value() == store.expected_value());
+        CHECK(full.dispersion() == store.dispersion());
+        CHECK(equal(full.kurtosis(), ed.kurtosis()) == true);
+        EmpiricalDistribution copy(full);
+        CHECK(copy.dispersion() == store.dispersion());
+    }
+    std::string bytes;
+    {
+        std::ifstream file("store_test.bin", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    for (uint64_t count : std::vector<uint64_t>{ 5, 7, 1ull << 60 }) {
+        std::string corrupt = bytes;
+        for (int i = 0; i < 8; ++i) {
+            corrupt[corrupt.size() - 16 + i] = (char)(count >> (8 * i));
+        }
+        {
+            std::ofstream file("store_test.bin", std::ios::binary);
+            file << corrupt;
+        }
+        CHECK_THROWS_AS(SampleStore("store_test.bin"), int);
+    }
+    uint64_t directory = 0;
+    for (int i = 0; i < 8; ++i) {
+        directory |= (uint64_t)(unsigned char)bytes[bytes.size() - 8 + i] << (8 * i);
+    }
+    auto patch_entry = [&](int field, uint64_t value) {
+        std::string corrupt = bytes;
+        for (int i = 0; i < 8; ++i) {
+            corrupt[directory + 8 * field + i] = (char)(value >> (8 * i));
+        }
+        std::ofstream file("store_test.bin", std::ios::binary);
+        file << corrupt;
+    };
+    for (uint64_t count : std::vector<uint64_t>{ 0, 1001, 1ull << 40 }) {
+        patch_entry(2, count);
+        CHECK_THROWS_AS(SampleStore("store_test.bin"), int);
+    }
+    patch_entry(0, directory + 1000);
+    CHECK_THROWS_AS(SampleStore("store_test.bin"), int);
+    patch_entry(1, 1ull << 62);
+    CHECK_THROWS_AS(SampleStore("store_test.bin"), int);
+    std::vector<double> constant(3000, 1.5);
+    SampleStore::write("store_test.bin", constant, SampleCodec::delta_bitpack, 1000);
+    CHECK(SampleStore("store_test.bin").read_all() == constant);
+    std::remove("store_test.bin");
+}
+
+TEST_CASE("asynchronous writer") {
+    std::stringstream stream;
+    {
+        AsyncWriter writer(stream, 2, 64);
+        for (int i = 0; i < 1000; ++i) {
+            writer.push(i, i * 0.5);
+        }
+    }
+    auto values = TextFormat::read_doubles(stream);
+    REQUIRE(values.size() == 2000);
+    CHECK(values[0] == 0);
+    CHECK(values[1999] == 499.5);
+    CHECK(stream.str().substr(0, 10) == "0\t0\n1\t0.5\n");
+}
+
+TEST_CASE("graph selection in structure of arrays form") {
+    LaplaceDistribution distr1(1, -1, 1);
+    LaplaceDistribution distr2(2, 1, 0.5);
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mdistr(distr1, distr2, 0.4);
+    auto selection = mdistr.generate_selection(300);
+    auto graph = mdistr.generate_graph_selection(selection);
+    CHECK(graph.x.data() == selection.data());
+    REQUIRE(graph.density.size() == selection.size());
+    for (size_t i = 0; i < selection.size(); i += 37) {
+        CHECK(equal(graph.density[i], mdistr.density(selection[i])) == true);
+    }
+    std::vector<double> density(selection.size());
+    distr1.batch_density(selection, density);
+    CHECK(equal(density[10], distr1.density(selection[10])) == true);
+
+    std::vector<double> short_result(selection.size() - 1);
+    EmpiricalDistribution ed(selection);
+    FlatMixtureDistribution flat({ std::make_shared<LaplaceDistribution>(distr1), std::make_shared<LaplaceDistribution>(distr2) }, { 0.6, 0.4 });
+    CHECK_THROWS_AS(distr1.batch_density(selection, short_result), int);
+    CHECK_THROWS_AS(LaplaceDistribution(5, 0, 1).batch_density(selection, short_result), int);
+    CHECK_THROWS_AS(mdistr.batch_density(selection, short_result), int);
+    CHECK_THROWS_AS(ed.batch_density(selection, short_result), int);
+    CHECK_THROWS_AS(flat.batch_density(selection, short_result), int);
+}
+
+TEST_CASE("performance counters") {
+    PerfCounters counters;
+    LaplaceDistribution distr;
+    std::vector<double> selection;
+    PerfReading reading = counters.measure([&] { selection = distr.generate_selection(1000); }, 1000);
+    CHECK(reading.valid == counters.is_available());
+    if (reading.valid) {
+        CHECK(reading.instructions > 0);
+    }
+}
+
+TEST_CASE("distribution call statistics") {
+    DistributionStats::reset();
+    LaplaceDistribution distr1(2, 0, 1);
+    LaplaceDistribution distr2;
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mdistr(distr1, distr2, 0.5);
+    mdistr.density(0.5);
+    mdistr.generate_selection(10);
+    std::stringstream dump;
+    DistributionStats::dump(dump);
+#ifdef DISTRIBUTION_STATS
+    CHECK(dump.str().find("mixture") != std::string::npos);
+    CHECK(dump.str().find("(inside mixture") != std::string::npos);
+    CHECK(dump.str().find("rng_draw") != std::string::npos);
+#else
+    CHECK(dump.str().empty());
+#endif
+}
+
+TEST_CASE("tracing spans") {
+    Tracing::clear();
+    {
+        Tracing::Span outer("test", "outer");
+        Tracing::Span inner("test", "inner \"quoted\"");
+    }
+    std::thread([] { Tracing::Span span("test", "worker"); }).join();
+    LaplaceDistribution distr;
+    EmpiricalDistribution edistr(distr.generate_selection(100));
+#ifdef DISTRIBUTION_TRACING
+    CHECK(Tracing::events_number() > 3);
+#else
+    CHECK(Tracing::events_number() == 3);
+#endif
+    std::stringstream trace;
+    Tracing::write_chrome_trace(trace);
+    CHECK(trace.str().rfind("{\"traceEvents\":[", 0) == 0);
+    CHECK(trace.str().find("\"name\":\"inner \\\"quoted\\\"\"") != std::string::npos);
+    CHECK(trace.str().find("\"name\":\"worker\"") != std::string::npos);
+#ifdef DISTRIBUTION_TRACING
+    CHECK(trace.str().find("empirical::create_empirical_density") != std::string::npos);
+#endif
+    Tracing::clear();
+    CHECK(Tracing::events_number() == 0);
+}
+
+TEST_CASE("fixed form laplace kernels") {
+    CHECK(LaplaceKernels::fixed_form(4) == 4);
+    CHECK(LaplaceKernels::fixed_form(9) == 0);
+    CHECK(LaplaceKernels::fixed_form(2.5) == 0);
+    for (double x : { 0.0, 0.7, -1.5, 4.0 }) {
+        CHECK(LaplaceKernel<1>::density(x) == Approx(exp(-fabs(x)) / 2));
+        CHECK(LaplaceKernel<2>::density(x) == Approx(exp(-fabs(x)) * (1 + fabs(x)) / 4));
+        CHECK(LaplaceKernel<3>::density(x) == Approx(exp(-fabs(x)) * (x * x + 3 * fabs(x) + 3) / 16));
+    }
+    for (int n = 1; n <= LaplaceKernels::max_form; ++n) {
+        LaplaceDistribution distr(n, 1, 2);
+        double sum = 0;
+        for (double x = -60; x <= 60; x += 0.01) {
+            sum += distr.density(x) * 0.01;
+        }
+        CHECK(sum == Approx(1).epsilon(0.001));
+        auto sample = distr.generate_selection(20000);
+        EmpiricalDistribution edistr(sample);
+        CHECK(equal(edistr.dispersion() / distr.dispersion(), 1));
+    }
+}
+
+TEST_CASE("factorial tables") {
+    static_assert(FactorialTable::factorials[5] == 120);
+    CHECK(FactorialTable::factorial(20.0) == Approx(2432902008176640000.0));
+    CHECK(FactorialTable::factorial(0.5) == Approx(std::tgamma(1.5)));
+    CHECK(FactorialTable::log_factorial(1000.0) == Approx(std::lgamma(1001.0)));
+    CHECK(FactorialTable::log_factorial(5000.0) == Approx(std::lgamma(5001.0)));
+    CHECK(FactorialTable::laplace_coefficient(3, 2) == Approx(3.0 / 16));
+    CHECK(FactorialTable::log_laplace_coefficient(100, 10) == Approx(std::lgamma(110.0) - std::lgamma(90.0) - std::lgamma(11.0) - std::lgamma(100.0) - 110 * log(2.0)));
+    for (double n : { 9.0, 20.0, 64.0, 200.0 }) {
+        LaplaceDistribution distr(n, 0, 1);
+        double sum = 0;
+        for (double x = -400; x <= 400; x += 0.02) {
+            sum += distr.density(x) * 0.02;
+        }
+        CHECK(sum == Approx(1).epsilon(0.001));
+    }
+}
+
+TEST_CASE("classical laplace fast path") {
+    CHECK(LaplaceKernel<1>::inverse_transform(0.25) == Approx(log(0.5)));
+    CHECK(LaplaceKernel<1>::inverse_transform(0.5) == 0);
+    CHECK(LaplaceKernel<1>::inverse_transform(0.875) == Approx(-log(0.25)));
+    LaplaceDistribution distr(1, 3, 0.5);
+    std::vector<double> x = { -1.0, 2.5, 3.0, 3.25, 10.0 };
+    std::vector<double> density(x.size());
+    distr.batch_density(x, density);
+    for (size_t i = 0; i < x.size(); ++i) {
+        CHECK(density[i] == Approx(exp(-fabs(x[i] - 3) / 0.5) / (2 * 0.5)));
+        CHECK(density[i] == Approx(distr.density(x[i])));
+    }
+    auto sample = distr.generate_selection(20000);
+    CHECK(std::is_sorted(sample.begin(), sample.end()));
+    std::vector<double> copy = sample;
+    CHECK(fabs(LaplaceDistribution::fit_shift(copy) - 3) < 0.05);
+    CHECK(LaplaceDistribution::fit_scale(sample, 3) == Approx(0.5).epsilon(0.05));
+}
+
+TEST_CASE("ziggurat laplace sampler") {
+    const int size = 200000;
+    double sum = 0;
+    int tail = 0, negative = 0;
+    for (int i = 0; i < size; ++i) {
+        double e = ZigguratExponential::sample();
+        sum += e;
+        tail += e > 3;
+        negative += e < 0;
+    }
+    CHECK(negative == 0);
+    CHECK(sum / size == Approx(1).epsilon(0.02));
+    CHECK((double)tail / size == Approx(exp(-3)).epsilon(0.05));
+    for (int n : { 1, 3 }) {
+        LaplaceDistribution distr(n, 2, 0.5);
+        distr.set_sampler(LaplaceSampler::ziggurat);
+        CHECK(distr.get_sampler() == LaplaceSampler::ziggurat);
+        EmpiricalDistribution edistr(distr.generate_selection(size));
+        CHECK(edistr.expected_value() == Approx(2).epsilon(0.01));
+        CHECK(edistr.dispersion() == Approx(distr.dispersion()).epsilon(0.03));
+        CHECK(edistr.kurtosis() == Approx(distr.kurtosis()).epsilon(0.1));
+    }
+}
+
+TEST_CASE("vector math kernels") {
+    std::vector<double> x;
+    for (double v = -708; v < 709; v += 0.37) {
+        x.push_back(v);
+    }
+    x.push_back(NAN);
+    std::vector<double> result(x.size()), reference(x.size());
+    for (const VectorMath::Kernels* kernels : { &VectorMath::scalar(), VectorMath::avx2(), VectorMath::avx512() }) {
+        if (!kernels) {
+            continue;
+        }
+        kernels->exp(x.data(), result.data(), x.size());
+        double error = 0;
+        for (size_t i = 0; i + 1 < x.size(); ++i) {
+            error = std::max(error, fabs(result[i] / std::exp(x[i]) - 1));
+        }
+        CHECK(error < 4e-16);
+        CHECK(std::isnan(result.back()));
+        std::vector<double> positive = { 0.0, 5e-324, 1e-310, 0.5, 1.0, 1.0000001, 2.0, 1e300, INFINITY, -1.0, 3.0 };
+        std::vector<double> logs(positive.size());
+        kernels->log(positive.data(), logs.data(), positive.size());
+        CHECK(logs[0] == -INFINITY);
+        for (size_t i = 1; i + 3 < positive.size(); ++i) {
+            CHECK(logs[i] == Approx(std::log(positive[i])).epsilon(1e-15).margin(1e-300));
+        }
+        CHECK(logs[8] == INFINITY);
+        CHECK(std::isnan(logs[9]));
+        CHECK(logs[10] == Approx(std::log(3.0)));
+        double coefficients[] = { 2, -1, 0.5 };
+        kernels->polynomial(positive.data() + 3, coefficients, 2, reference.data(), 5);
+        CHECK(reference[0] == Approx(2 * 0.25 - 0.5 + 0.5));
+        CHECK(reference[3] == Approx(2 * 4 - 2 + 0.5));
+        kernels->abs(x.data(), result.data(), x.size());
+        CHECK(result[0] == 708);
+    }
+    CHECK(VectorMath::exp(1.0) == Approx(std::exp(1.0)).epsilon(1e-15));
+    CHECK(VectorMath::log(10.0) == Approx(std::log(10.0)).epsilon(1e-15));
+    CHECK(std::string(VectorMath::instruction_set()).size() > 0);
+}
+
+TEST_CASE("runtime instruction set dispatch") {
+    CHECK((VectorMath::avx512() != nullptr) == CpuFeatures::avx512f());
+    CHECK((VectorMath::avx2() != nullptr) == (CpuFeatures::avx2() && CpuFeatures::fma()));
+    const std::string initial = VectorMath::instruction_set();
+    CHECK(initial == (CpuFeatures::avx512f() ? "avx512" : CpuFeatures::avx2() && CpuFeatures::fma() ? "avx2" : "scalar"));
+    CHECK_FALSE(VectorMath::set_instruction_set("sse9"));
+    CHECK(VectorMath::instruction_set() == initial);
+    LaplaceDistribution distr(3, 1, 2);
+    std::vector<double> x;
+    for (double v = -20; v < 20; v += 0.1) {
+        x.push_back(v);
+    }
+    std::vector<double> expected(x.size()), density(x.size());
+    REQUIRE(VectorMath::set_instruction_set("scalar"));
+    distr.batch_density(x, expected);
+    for (const char* name : { "avx2", "avx512" }) {
+        if (VectorMath::set_instruction_set(name)) {
+            CHECK(VectorMath::instruction_set() == std::string(name));
+            distr.batch_density(x, density);
+            double error = 0;
+            for (size_t i = 0; i < x.size(); ++i) {
+                error = std::max(error, fabs(density[i] / expected[i] - 1));
+            }
+            CHECK(error < 1e-14);
+        }
+    }
+    VectorMath::set_instruction_set(initial);
+}
+
+TEST_CASE("sobol quasi monte carlo sampling") {
+    const double cell = 1.0 / 4294967296.0;
+    SobolSequence plain(2, false);
+    std::vector<double> point(2);
+    const double expected[4][2] = { { 0, 0 }, { 0.5, 0.5 }, { 0.75, 0.25 }, { 0.25, 0.75 } };
+    for (const auto& e : expected) {
+        plain.next(point);
+        CHECK(point[0] == e[0] + cell / 2);
+        CHECK(point[1] == e[1] + cell / 2);
+    }
+    CHECK(plain.get_index() == 4);
+    plain.reset();
+    CHECK(plain.next() == cell / 2);
+    CHECK_THROWS_AS(plain.next(std::span<double>(point.data(), 1)), int);
+    CHECK_THROWS_AS(SobolSequence(SobolSequence::max_dimensions + 1), int);
+
+    SobolSequence scrambled;
+    std::vector<int> strata(1024, 0);
+    for (int i = 0; i < 1024; ++i) {
+        strata[(int)(scrambled.next() * 1024)]++;
+    }
+    CHECK(std::count(strata.begin(), strata.end(), 1) == 1024);
+
+    for (double n : { 1.0, 2.0, 5.0, 12.0, 80.0 }) {
+        LaplaceDistribution distr(n, 1, 2);
+        CHECK(distr.quantile(0.5) == 1);
+        for (double p : { 1e-9, 0.01, 0.3, 0.77, 0.999 }) {
+            CHECK(fabs(distr.distribution_function(distr.quantile(p)) / p - 1) < 1e-9);
+        }
+    }
+    CHECK(LaplaceDistribution(1, 0, 1).quantile(0) == -std::numeric_limits<double>::infinity());
+    CHECK_THROWS_AS(LaplaceDistribution(1, 0, 1).quantile(1.5), int);
+    CHECK_THROWS_AS(LaplaceDistribution(2.5, 0, 1).quantile(0.5), int);
+
+    LaplaceDistribution laplace(3, 1, 2);
+    SobolSequence sequence;
+    auto selection = laplace.generate_quasi_selection(4096, sequence);
+    CHECK(std::is_sorted(selection.begin(), selection.end()));
+    double mean = 0, dispersion = 0;
+    for (double x : selection) {
+        mean += x / selection.size();
+    }
+    for (double x : selection) {
+        dispersion += (x - mean) * (x - mean) / selection.size();
+    }
+    CHECK(fabs(mean - laplace.expected_value()) < 0.01);
+    CHECK(fabs(dispersion / laplace.dispersion() - 1) < 0.01);
+
+    LaplaceDistribution distr1(1, -1, 1);
+    LaplaceDistribution distr2(2, 1, 0.5);
+    MixtureDistribution<LaplaceDistribution, LaplaceDistribution> mdistr(distr1, distr2, 0.4);
+    FlatMixtureDistribution flat({ std::make_shared<LaplaceDistribution>(distr1), std::make_shared<LaplaceDistribution>(distr2) }, { 0.6, 0.4 });
+    EmpiricalDistribution ed(selection);
+    for (double p : { 0.001, 0.2, 0.5, 0.9 }) {
+        CHECK(fabs(mdistr.distribution_function(mdistr.quantile(p)) - p) < 1e-12);
+        CHECK(fabs(flat.quantile(p) - mdistr.quantile(p)) < 1e-9);
+        CHECK(fabs(ed.distribution_function(ed.quantile(p)) - p) < 1e-12);
+    }
+    CHECK(ed.quantile(0) >= selection.front());
+    CHECK(ed.quantile(1) <= selection.back());
+    ed.set_kernel_density(Kernel::gaussian);
+    CHECK(fabs(ed.distribution_function(ed.quantile(0.3)) - 0.3) < 1e-12);
+}
+
+TEST_CASE("empirical distribution of degenerate samples") {
+    std::vector<double> empty;
+    CHECK_THROWS_AS(EmpiricalDistribution(empty), int);
+    CHECK_THROWS_AS(EmpiricalDistribution(std::vector<double>()), int);
+    std::vector<double> constant(100, 2.5);
+    CHECK_THROWS_AS(EmpiricalDistribution(constant), int);
+    CHECK_THROWS_AS(EmpiricalDistribution(constant, false), int);
+    std::vector<double> nearly_constant(constant);
+    nearly_constant[50] = 3.5;
+    EmpiricalDistribution ed(nearly_constant, false);
+    CHECK(ed.density(2.5) > 0);
+    CHECK(ed.density(3.45) > 0);
+}
+
+TEST_CASE("version 1 empirical payloads") {
+    std::vector<double> sample = { -1.5, -0.25, 0, 0.5, 2, 3.75 };
+    std::ostringstream payload;
+    payload.write("DMBF", 4);
+    BinaryFormat::write_integer(payload, 1, 2);
+    BinaryFormat::write_integer(payload, (uint8_t)DistributionTag::empirical, 1);
+    BinaryFormat::write_integer(payload, 0, 1);
+    BinaryFormat::write_integer(payload, 3, 4);
+    BinaryFormat::write_integer(payload, sample.size(), 8);
+    BinaryFormat::write_doubles(payload, sample.data(), sample.size());
+
+    std::istringstream stream(payload.str());
+    EmpiricalDistribution ed(sample);
+    ed.load_from_binary(stream);
+    CHECK(ed.get_intrevals_number() == 3);
+    CHECK(std::equal(sample.begin(), sample.end(), ed.get_selection().begin(), ed.get_selection().end()));
+
+    std::istringstream flat_stream(payload.str());
+    FlatMixtureDistribution flat = FlatMixtureDistribution::load_from_binary(flat_stream);
+    CHECK(flat.get_components_number() == 1);
+    CHECK(flat.component(0).expected_value() == ed.expected_value());
+
+    {
+        std::ofstream file("empirical_v1.bin", std::ios::binary);
+        file << payload.str();
+    }
+    EmpiricalDistribution mapped = EmpiricalDistribution::map_binary("empirical_v1.bin");
+    CHECK_FALSE(mapped.is_mapped());
+    CHECK(std::equal(sample.begin(), sample.end(), mapped.get_selection().begin(), mapped.get_selection().end()));
+
+    std::ostringstream resaved;
+    mapped.save_in_binary(resaved);
+    std::istringstream resaved_stream(resaved.str());
+    CHECK(BinaryFormat::expect_header(resaved_stream, DistributionTag::empirical) == (int)BinaryFormat::version);
+    EmpiricalDistribution reloaded(sample);
+    resaved_stream.seekg(0);
+    reloaded.load_from_binary(resaved_stream);
+    CHECK(std::equal(sample.begin(), sample.end(), reloaded.get_selection().begin(), reloaded.get_selection().end()));
+    std::remove("empirical_v1.bin");
+}
+
+TEST_CASE("flat mixture rejects corrupt trees") {
+    std::ostringstream huge;
+    BinaryFormat::write_header(huge, DistributionTag::flat_mixture);
+    BinaryFormat::write_integer(huge, 1ull << 40, 8);
+    BinaryFormat::write_double(huge, 1);
+    std::istringstream huge_stream(huge.str());
+    CHECK_THROWS_AS(FlatMixtureDistribution::load_from_binary(huge_stream), int);
+
+    std::ostringstream deep;
+    for (int i = 0; i < 1000; ++i) {
+        BinaryFormat::write_header(deep, DistributionTag::mixture);
+        BinaryFormat::write_double(deep, 0.5);
+    }
+    std::istringstream deep_stream(deep.str());
+    CHECK_THROWS_AS(FlatMixtureDistribution::load_from_binary(deep_stream), int);
+
+    std::ostringstream valid;
+    LaplaceDistribution(1, 0, 1).save_in_binary(valid);
+    std::ostringstream flat;
+    BinaryFormat::write_header(flat, DistributionTag::flat_mixture);
+    BinaryFormat::write_integer(flat, 1, 8);
+    BinaryFormat::write_double(flat, 1);
+    flat << valid.str();
+    std::istringstream flat_stream(flat.str());
+    CHECK(FlatMixtureDistribution::load_from_binary(flat_stream).get_components_number() == 1);
+
+    for (double w : { std::nan(""), -0.5, 2.0 }) {
+        std::ostringstream weighted;
+        BinaryFormat::write_header(weighted, DistributionTag::flat_mixture);
+        BinaryFormat::write_integer(weighted, 1, 8);
+        BinaryFormat::write_double(weighted, w);
+        weighted << valid.str();
+        std::istringstream weighted_stream(weighted.str());
+        CHECK_THROWS_AS(FlatMixtureDistribution::load_from_binary(weighted_stream), int);
+
+        std::ostringstream mixture;
+        BinaryFormat::write_header(mixture, DistributionTag::mixture);
+        BinaryFormat::write_double(mixture, w);
+        mixture << valid.str() << valid.str();
+        std::istringstream mixture_stream(mixture.str());
+        CHECK_THROWS_AS(FlatMixtureDistribution::load_from_binary(mixture_stream), int);
+    }
 }
\ No newline at end of file
@@ -1,8 +1,20 @@
 #pragma once
+#include "distribution_stats.h"
+#include "tracing.h"
+#include "sobol_sequence.h"
+#include <span>
 #include <vector>
 #include <fstream>
+#include <string>
 #include <algorithm>
 
+// Density graph in structure-of-arrays form. x views the selection the graph
+// was built from, so that selection must outlive it.
+struct GraphSelection {
+	std::span<const double> x;
+	std::vector<double> density;
+};
+
 class IDistribution {
 public:
 	double virtual density(const double x) const = 0;
@@ -11,12 +23,59 @@ public:
 	double virtual kurtosis() const = 0;
 	double virtual asymmetry() const = 0;
 	double virtual rand_var() const = 0;
+	double virtual distribution_function(const double x) const = 0;
+	// Inverse of distribution_function for p in [0, 1].
+	double virtual quantile(const double p) const = 0;
 	std::vector<double> virtual generate_selection(const int n) const = 0;
-	std::vector<std::pair<double, double>> virtual generate_graph_selection(const std::vector<double>& selection) const = 0;
+	// result must hold at least x.size() values, a shorter span throws 1.
+	void virtual batch_density(std::span<const double> x, std::span<double> result) const = 0;
+	GraphSelection virtual generate_graph_selection(std::span<const double> selection) const = 0;
+
+	// Inverse-transform selection from the next n points of a Sobol sequence instead of rand().
+	// The quantile is monotone, so sorting the points first leaves the selection ordered like generate_selection.
+	std::vector<double> generate_quasi_selection(const int n, SobolSequence& sequence) const {
+		DISTRIBUTION_TRACE("sampling", "generate_quasi_selection");
+		if (n < 0) {
+			throw 1;
+		}
+		std::vector<double> sample(n);
+		for (double& u : sample) {
+			u = sequence.next();
+		}
+		std::sort(sample.begin(), sample.end());
+		for (double& x : sample) {
+			x = quantile(x);
+		}
+		return sample;
+	}
 };
 
 class IPresistend {
 public:
-	void virtual load_from_file(std::ifstream& file) = 0;
-	void virtual save_in_file(std::ofstream& file) = 0;
+	void virtual load_from_file(std::istream& file) = 0;
+	void virtual save_in_file(std::ostream& file) = 0;
+	void virtual load_from_binary(std::istream& file) = 0;
+	void virtual save_in_binary(std::ostream& file) = 0;
+
+	void load_from_path(const std::string& path, const bool binary = false) {
+		DISTRIBUTION_TRACE("persistence", "load_from_path");
+		std::ifstream file(path, binary ? std::ios::in | std::ios::binary : std::ios::in);
+		if (!file.is_open()) {
+			throw 0;
+		}
+		binary ? load_from_binary(file) : load_from_file(file);
+	}
+
+	void save_in_path(const std::string& path, const bool binary = false) {
+		DISTRIBUTION_TRACE("persistence", "save_in_path");
+		std::ofstream file(path, binary ? std::ios::out | std::ios::binary : std::ios::out);
+		if (!file.is_open()) {
+			throw 0;
+		}
+		binary ? save_in_binary(file) : save_in_file(file);
+		file.close();
+		if (!file) {
+			throw 0;
+		}
+	}
 };
\ No newline at end of file
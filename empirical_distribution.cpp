@@ -1,69 +1,198 @@
 #include "empirical_distribution.h"
+#include "binary_format.h"
+#include "text_format.h"
+#include <climits>
+#include <execution>
+#include <sstream>
 
 EmpiricalDistribution::EmpiricalDistribution(const IDistribution& d, int n, int _k):
 	size(n > 1 ? n : throw 1), k(_k > 2 ? _k : (int)log2(size) + 1) {
-	selection = d.generate_selection(size);
-	empirical_density = create_empirical_density(delta_calc(), create_intervals(delta_calc()));
+	storage = d.generate_selection(size);
+	prepare_selection(true);
+	rebuild_density();
 }
 
 EmpiricalDistribution::EmpiricalDistribution(const EmpiricalDistribution& ed):
-	size(ed.size > 1 ? ed.size : throw 1), k(ed.k > 2 ? ed.k : ((int)log2(size) + 1)), selection(ed.selection), empirical_density(ed.empirical_density) {
-	empirical_density = create_empirical_density(delta_calc(), create_intervals(delta_calc()));
+	storage(ed.storage), mapping(ed.mapping), empirical_density(ed.empirical_density), kernel_density(ed.kernel_density), summary(ed.summary), size(ed.size > 1 ? ed.size : throw 1), k(ed.k > 2 ? ed.k : ((int)log2(size) + 1)), lower(ed.lower), upper(ed.upper), ordered(ed.ordered) {
+	bind_selection();
+	if (k != ed.k) {
+		rebuild_density();
+	}
+}
+
+EmpiricalDistribution::EmpiricalDistribution(EmpiricalDistribution&& ed) noexcept:
+	storage(std::move(ed.storage)), mapping(std::move(ed.mapping)), empirical_density(std::move(ed.empirical_density)), kernel_density(std::move(ed.kernel_density)), summary(std::move(ed.summary)), size(ed.size), k(ed.k), lower(ed.lower), upper(ed.upper), ordered(ed.ordered) {
+	bind_selection();
+	ed.kernel_density.reset();
+	ed.summary.reset();
+	ed.size = 0;
+	ed.bind_selection();
 }
 
-EmpiricalDistribution::EmpiricalDistribution(std::ifstream& file) {
-	file.open("eparams.txt");
-	if (!file.is_open()) {
+EmpiricalDistribution::EmpiricalDistribution(std::istream& file) {
+	if (!file) {
 		throw 0;
 	}
-	double x;
-	while (file >> x) {
-		selection.push_back(x);
-	}
-	size = selection.size();
-	k = (int)log2(size) + 1;
-	empirical_density = create_empirical_density(delta_calc(), create_intervals(delta_calc()));
+	storage = TextFormat::read_doubles(file);
+	size = storage.size();
+	k = default_intervals_number(size);
+	prepare_selection(true);
+	rebuild_density();
 }
 
-EmpiricalDistribution::EmpiricalDistribution(const std::vector<double>& selection):
-	size(selection.size()), k((int)log2(size) + 1), selection(selection) {
-	empirical_density = create_empirical_density(delta_calc(), create_intervals(delta_calc()));
+EmpiricalDistribution::EmpiricalDistribution(const std::vector<double>& selection, bool ordered):
+	storage(selection), size(selection.size()), k(default_intervals_number(size)) {
+	prepare_selection(ordered);
+	rebuild_density();
+}
+
+EmpiricalDistribution::EmpiricalDistribution(std::vector<double>&& selection, bool ordered):
+	storage(std::move(selection)) {
+	size = storage.size();
+	k = default_intervals_number(size);
+	prepare_selection(ordered);
+	rebuild_density();
+}
+
+// Only the archived chunks overlapping [lower, upper] are decompressed. The histogram still needs the values,
+// but when the range covers the whole store the moments come from its directory instead of a pass over them.
+EmpiricalDistribution::EmpiricalDistribution(SampleStore& store, double lower, double upper):
+	storage(store.read_values(lower, upper)) {
+	size = storage.size();
+	k = default_intervals_number(size);
+	prepare_selection(true);
+	rebuild_density();
+	if (lower <= store.get_min() && upper >= store.get_max()) {
+		summary = store.get_summary();
+	}
 }
 
 EmpiricalDistribution::~EmpiricalDistribution() {
-	selection.clear();
+	storage.clear();
 	empirical_density.clear();
 }
 
-std::vector<double> EmpiricalDistribution::create_empirical_density(const double delta, std::vector<double> intervals) const {
+// The sample is used in place from the mapped file written by save_in_binary, nothing is copied or parsed.
+// A sample stored unsorted cannot be sorted in read-only memory and is used unordered.
+EmpiricalDistribution EmpiricalDistribution::map_binary(const std::string& path) {
+	DISTRIBUTION_TRACE("persistence", "empirical::map_binary");
+	auto copy = [&path] {
+		std::ifstream file(path, std::ios::binary);
+		EmpiricalDistribution ed;
+		ed.load_from_binary(file);
+		return ed;
+	};
+	if constexpr (std::endian::native != std::endian::little) {
+		return copy();
+	}
+	auto file = std::make_shared<const MappedFile>(path);
+	const size_t offset = BinaryFormat::header_size + sample_header_size;
+	if (file->size() < offset) {
+		throw 0;
+	}
+	std::string header(file->data(), offset);
+	std::istringstream stream(header);
+	// A version 1 payload has no flags word, so its sample is not where the mapping expects it: it is copied instead.
+	if (BinaryFormat::expect_header(stream, DistributionTag::empirical) < 2) {
+		return copy();
+	}
+	int k = (int)BinaryFormat::read_integer(stream, 4);
+	bool sorted = BinaryFormat::read_integer(stream, 4) & sorted_flag;
+	uint64_t size = BinaryFormat::read_integer(stream, 8);
+	if (size < 1 || size > (uint64_t)INT_MAX || file->size() < offset + size * sizeof(double)) {
+		throw 1;
+	}
+	EmpiricalDistribution ed;
+	ed.mapping = file;
+	ed.size = (int)size;
+	ed.k = stored_intervals_number(k, ed.size);
+	ed.bind_selection();
+	if (sorted) {
+		ed.ordered = true;
+		ed.lower = ed.selection.front();
+		ed.upper = ed.selection.back();
+	}
+	else {
+		ed.prepare_selection(false);
+	}
+	ed.rebuild_density();
+	return ed;
+}
+
+void EmpiricalDistribution::bind_selection() {
+	if (mapping) {
+		selection = std::span<const double>((const double*)(mapping->data() + BinaryFormat::header_size + sample_header_size), size);
+	}
+	else {
+		selection = storage;
+	}
+}
+
+// A sorted selection gives every interval count as a difference of two binary searches: O(k log n) instead of a pass over the sample.
+// An unordered selection falls back to a single bucketing pass.
+std::vector<double> EmpiricalDistribution::create_empirical_density(const double delta, const std::vector<double>& intervals) const {
+	DISTRIBUTION_TRACE("construction", "empirical::create_empirical_density");
 	std::vector<double> result;
-	int j = 0;
-	for (int i = 0; i < intervals.size() - 1; ++i) {
-		int count = 0;
-		for (j; j < size; ++j) {
-			if (i + 1 == intervals.size() - 1) {
-				if (selection[j] <= intervals[i + 1]) {
-					++count;
-				}
-				else {
-					break;
-				}
-			}
-			else {
-				if (selection[j] < intervals[i + 1]) {
-					++count;
-				}
-				else {
-					break;
-				}
-			}
+	result.reserve(intervals.size() - 1);
+	if (!ordered) {
+		std::vector<int> counts(intervals.size() - 1, 0);
+		for (int j = 0; j < size; ++j) {
+			counts[std::min((int)((selection[j] - lower) / delta), (int)counts.size() - 1)]++;
 		}
-		result.push_back(count / (size * delta));
+		for (int count : counts) {
+			result.push_back(count / (size * delta));
+		}
+		return result;
+	}
+	auto first = selection.begin();
+	for (size_t i = 0; i < intervals.size() - 1; ++i) {
+		auto last = i + 1 == intervals.size() - 1 ? selection.end() : std::lower_bound(first, selection.end(), intervals[i + 1]);
+		result.push_back((last - first) / (size * delta));
+		first = last;
 	}
 	return result;
 }
 
+// Checks sortedness in one pass and sorts only when the caller asks for an ordered selection and it is not one yet.
+// Otherwise only the bounds are taken, which is all the histogram needs.
+void EmpiricalDistribution::prepare_selection(const bool ordered) {
+	DISTRIBUTION_TRACE("sorting", "empirical::prepare_selection");
+	if (size < 1) {
+		throw 1;
+	}
+	bind_selection();
+	this->ordered = std::is_sorted(selection.begin(), selection.end());
+	if (!this->ordered && ordered && !mapping) {
+		if (size >= parallel_sort_threshold) {
+			std::sort(std::execution::par_unseq, storage.begin(), storage.end());
+		}
+		else {
+			std::sort(storage.begin(), storage.end());
+		}
+		this->ordered = true;
+	}
+	if (this->ordered) {
+		lower = selection.front();
+		upper = selection.back();
+	}
+	else {
+		auto bounds = std::minmax_element(selection.begin(), selection.end());
+		lower = *bounds.first;
+		upper = *bounds.second;
+	}
+}
+
+// A constant sample has no spread to bin: every interval would have zero width and the densities would be NaN.
+void EmpiricalDistribution::rebuild_density() {
+	double delta = delta_calc();
+	if (!(delta > 0)) {
+		throw 1;
+	}
+	empirical_density = create_empirical_density(delta, create_intervals(delta));
+}
+
 double EmpiricalDistribution::random_var() const {
+	DISTRIBUTION_COUNT("empirical", rng_draw);
 	double r;
 	do r = (double)rand() / RAND_MAX; while (r == 0 || r == 1);
 	return r;
@@ -86,27 +215,108 @@ double EmpiricalDistribution::top_bound() const {
 }
 
 double EmpiricalDistribution::rand_var() const {
+	DISTRIBUTION_SCOPE("empirical", rand_var);
+	if (kernel_density) {
+		// rand() % size would favour low indices and, with a 15-bit RAND_MAX, never reach past 32767:
+		// a second draw fills in the low bits of a uniform index instead.
+		double r = (rand() + random_var()) / ((double)RAND_MAX + 1);
+		return kernel_density->rand_var(selection[std::min((int)(r * size), size - 1)]);
+	}
 	double r;
-	do r = (double)rand() / RAND_MAX * top_bound();
-	while (r == 0 || r == top_bound());
+	do {
+		DISTRIBUTION_COUNT("empirical", rng_draw);
+		r = (double)rand() / RAND_MAX * top_bound();
+	} while (r == 0 || r == top_bound());
 	for (int i = 0; i < k - 1; ++i) {
 		if (r > qumulative_probability(i) and r < qumulative_probability(i + 1)) {
-			do r = (double)rand() / RAND_MAX * ((selection[0] + delta_calc() * (i + 1)) - (selection[0] + delta_calc() * i)) + (selection[0] + delta_calc() * (i + 1));
-			while (r == (selection[0] + delta_calc() * i) || r == (selection[0] + delta_calc() * (i + 1)));
+			do {
+				DISTRIBUTION_COUNT("empirical", rng_draw);
+				r = (double)rand() / RAND_MAX * ((lower + delta_calc() * (i + 1)) - (lower + delta_calc() * i)) + (lower + delta_calc() * (i + 1));
+			} while (r == (lower + delta_calc() * i) || r == (lower + delta_calc() * (i + 1)));
 			break;
 		}
 	}
 	return r;
 }
 
+// Piecewise linear integral of the histogram, or of the kernel density estimate when one is set.
+double EmpiricalDistribution::distribution_function(const double x) const {
+	DISTRIBUTION_SCOPE("empirical", distribution_function);
+	if (kernel_density) {
+		return kernel_density->distribution_function(x);
+	}
+	if (x <= lower) {
+		return 0;
+	}
+	if (x >= upper) {
+		return 1;
+	}
+	double delta = delta_calc();
+	int i = std::min((int)((x - lower) / delta), k - 1);
+	double mass = empirical_density[i] * (x - (lower + delta * i));
+	for (int j = 0; j < i; ++j) {
+		mass += empirical_density[j] * delta;
+	}
+	return mass / (top_bound() * delta);
+}
+
+// Empty intervals are stepped over, so the quantile never falls where the density is zero.
+double EmpiricalDistribution::quantile(const double p) const {
+	DISTRIBUTION_SCOPE("empirical", quantile);
+	if (p < 0 || p > 1) {
+		throw 1;
+	}
+	if (kernel_density) {
+		return kernel_density->quantile(p);
+	}
+	double target = p * top_bound();
+	double cumulative = 0;
+	for (int i = 0; i < k; ++i) {
+		if (empirical_density[i] > 0 && cumulative + empirical_density[i] >= target) {
+			return std::min(upper, lower + delta_calc() * (i + (target - cumulative) / empirical_density[i]));
+		}
+		cumulative += empirical_density[i];
+	}
+	return upper;
+}
+
 EmpiricalDistribution& EmpiricalDistribution::operator = (const EmpiricalDistribution& ed) {
 	if (this == &ed) {
 		return *this;
 	}
-	selection = ed.selection;
+	storage = ed.storage;
+	mapping = ed.mapping;
 	empirical_density = ed.empirical_density;
+	kernel_density = ed.kernel_density;
+	summary = ed.summary;
+	size = ed.size;
+	k = ed.k;
+	lower = ed.lower;
+	upper = ed.upper;
+	ordered = ed.ordered;
+	bind_selection();
+	return *this;
+}
+
+EmpiricalDistribution& EmpiricalDistribution::operator = (EmpiricalDistribution&& ed) noexcept {
+	if (this == &ed) {
+		return *this;
+	}
+	storage = std::move(ed.storage);
+	mapping = std::move(ed.mapping);
+	empirical_density = std::move(ed.empirical_density);
+	kernel_density = std::move(ed.kernel_density);
+	summary = std::move(ed.summary);
 	size = ed.size;
 	k = ed.k;
+	lower = ed.lower;
+	upper = ed.upper;
+	ordered = ed.ordered;
+	bind_selection();
+	ed.kernel_density.reset();
+	ed.summary.reset();
+	ed.size = 0;
+	ed.bind_selection();
 	return *this;
 }
 
@@ -115,16 +325,28 @@ void EmpiricalDistribution::set_intrevals_number(const int k) {
 		this->k = k;
 	}
 	else {
-		this->k = (int)log2(size) + 1;
+		this->k = default_intervals_number(size);
 	}
-	empirical_density = create_empirical_density(delta_calc(), create_intervals(delta_calc()));
+	rebuild_density();
+}
+
+void EmpiricalDistribution::set_kernel_density(Kernel kernel, Bandwidth rule, int grid_size) {
+	kernel_density.emplace(selection, kernel, rule, grid_size);
 }
 
-std::vector<double> EmpiricalDistribution::get_selection() const {
+void EmpiricalDistribution::set_histogram_density() {
+	kernel_density.reset();
+}
+
+const std::optional<KernelDensity>& EmpiricalDistribution::get_kernel_density() const {
+	return kernel_density;
+}
+
+std::span<const double> EmpiricalDistribution::get_selection() const {
 	return selection;
 }
 
-std::vector<double> EmpiricalDistribution::get_empirical_density() const {
+std::span<const double> EmpiricalDistribution::get_empirical_density() const {
 	return empirical_density;
 }
 
@@ -132,17 +354,44 @@ int EmpiricalDistribution::get_size() const {
 	return size;
 }
 
+bool EmpiricalDistribution::is_ordered() const {
+	return ordered;
+}
+
+bool EmpiricalDistribution::is_mapped() const {
+	return mapping != nullptr;
+}
+
 int EmpiricalDistribution::get_intrevals_number() const {
 	return k;
 }
 
+// Sturges' rule. An empty sample is rejected here, before log2(0) is converted to an int.
+int EmpiricalDistribution::default_intervals_number(const int size) {
+	if (size < 1) {
+		throw 1;
+	}
+	return (int)log2(size) + 1;
+}
+
+// An interval count read from a file follows the constructors' rule, and one beyond the sample size is
+// rejected before create_intervals allocates for it.
+int EmpiricalDistribution::stored_intervals_number(const int k, const int size) {
+	if (k > size) {
+		throw 1;
+	}
+	return k > 2 ? k : default_intervals_number(size);
+}
+
 double EmpiricalDistribution::delta_calc() const {
-	return (selection[size - 1] - selection[0]) / (k);
+	return (upper - lower) / (k);
 }
 
 std::vector<double> EmpiricalDistribution::create_intervals(const double delta) const {
+	DISTRIBUTION_TRACE("construction", "empirical::create_intervals");
 	std::vector<double> intervals;
-	double slider = selection[0];
+	intervals.reserve(k + 1);
+	double slider = lower;
 	for (int i = 0; i < k + 1; ++i) {
 		intervals.push_back(slider);
 		slider += delta;
@@ -151,7 +400,11 @@ std::vector<double> EmpiricalDistribution::create_intervals(const double delta)
 }
 
 double EmpiricalDistribution::density(const double x) const {
-	double slider = selection[0];
+	DISTRIBUTION_SCOPE("empirical", density);
+	if (kernel_density) {
+		return kernel_density->density(x);
+	}
+	double slider = lower;
 	if (x < slider) {
 		return 0;
 	}
@@ -171,78 +424,130 @@ double EmpiricalDistribution::density(const double x) const {
 	return 0;
 }
 
-double EmpiricalDistribution::expected_value() const {
+// Sum of (x - mean)^order over the sample, or the directory sum of a store-backed sample.
+double EmpiricalDistribution::central_sum(const int order, const double mean) const {
+	if (summary) {
+		return order == 2 ? summary->m2 : order == 3 ? summary->m3 : summary->m4;
+	}
 	double sum = 0;
 	for (int i = 0; i < size; ++i) {
-		sum += selection[i];
+		sum += pow(selection[i] - mean, order);
 	}
-	return sum / size;
+	return sum;
 }
 
-double EmpiricalDistribution::dispersion() const {
+double EmpiricalDistribution::expected_value() const {
+	DISTRIBUTION_SCOPE("empirical", moments);
+	if (summary) {
+		return summary->mean;
+	}
 	double sum = 0;
-	double exp_val = expected_value();
 	for (int i = 0; i < size; ++i) {
-		sum += pow(selection[i] - exp_val, 2);
+		sum += selection[i];
 	}
 	return sum / size;
 }
 
+double EmpiricalDistribution::dispersion() const {
+	DISTRIBUTION_SCOPE("empirical", moments);
+	return central_sum(2, expected_value()) / size;
+}
+
 double EmpiricalDistribution::asymmetry() const {
-	double sum = 0;
-	double exp_val = expected_value();
-	for (int i = 0; i < size; ++i) {
-		sum += pow(selection[i] - exp_val, 3);
-	}
-	return sum / (size * pow(dispersion(), 3 / 2));
+	DISTRIBUTION_SCOPE("empirical", moments);
+	return central_sum(3, expected_value()) / (size * pow(dispersion(), 3 / 2));
 }
 
 double EmpiricalDistribution::kurtosis() const {
-	double sum = 0;
-	double exp_val = expected_value();
-	for (int i = 0; i < size; ++i) {
-		sum += pow(selection[i] - exp_val, 4);
-	}
-	return (sum / (size * pow(dispersion(), 2))) - 3;
+	DISTRIBUTION_SCOPE("empirical", moments);
+	return (central_sum(4, expected_value()) / (size * pow(dispersion(), 2))) - 3;
 }
 
 std::vector<double>  EmpiricalDistribution::generate_selection(const int n) const {
+	DISTRIBUTION_SCOPE("empirical", generate_selection);
+	DISTRIBUTION_TRACE("sampling", "empirical::generate_selection");
 	std::vector<double> result;
 	for (int i = 0; i < n; ++i) {
 		result.push_back(rand_var());
 	}
-	sort(result.begin(), result.end());
+	{
+		DISTRIBUTION_TRACE("sorting", "empirical::sort_selection");
+		sort(result.begin(), result.end());
+	}
 	return result;
 }
 
-std::vector<std::pair<double, double>> EmpiricalDistribution::generate_graph_selection(const std::vector<double>& selection) const {
-	std::vector <std::pair<double, double >> result;
-	for (int j = 0; j < size; ++j) {
-		result.push_back(std::make_pair(selection[j], density(selection[j])));
+void EmpiricalDistribution::batch_density(std::span<const double> x, std::span<double> result) const {
+	DISTRIBUTION_SCOPE("empirical", batch_density);
+	if (result.size() < x.size()) {
+		throw 1;
+	}
+	for (size_t i = 0; i < x.size(); ++i) {
+		result[i] = density(x[i]);
 	}
+}
+
+GraphSelection EmpiricalDistribution::generate_graph_selection(std::span<const double> selection) const {
+	GraphSelection result{ selection, std::vector<double>(selection.size()) };
+	batch_density(selection, result.density);
 	return result;
 }
 
-void EmpiricalDistribution::save_in_file(std::ofstream& file){
-	file.open("eparams.txt");
-	for (int i = 0; i < size; ++i) {
-		file << selection[i] << " " << std::endl;
+void EmpiricalDistribution::save_in_file(std::ostream& file){
+	TextFormat::write_doubles(file, selection);
+}
+
+// The sample is a plain list of numbers, so it takes the rest of the stream.
+void EmpiricalDistribution::load_from_file(std::istream& file) {
+	if (!file) {
+		throw 0;
+	}
+	storage = TextFormat::read_doubles(file);
+	mapping.reset();
+	kernel_density.reset();
+	summary.reset();
+	size = storage.size();
+	k = default_intervals_number(size);
+	prepare_selection(true);
+	rebuild_density();
+}
+
+void EmpiricalDistribution::save_in_binary(std::ostream& file) {
+	BinaryFormat::write_header(file, DistributionTag::empirical);
+	BinaryFormat::write_integer(file, k, 4);
+	BinaryFormat::write_integer(file, ordered ? sorted_flag : 0, 4);
+	BinaryFormat::write_integer(file, size, 8);
+	BinaryFormat::write_doubles(file, selection.data(), size);
+}
+
+void EmpiricalDistribution::load_from_binary(std::istream& file) {
+	if (!file) {
+		throw 0;
 	}
-	file.close();
+	load_binary_payload(file, BinaryFormat::expect_header(file, DistributionTag::empirical));
 }
 
-void EmpiricalDistribution::load_from_file(std::ifstream& file) {
-	file.open("emparams.txt");
-	if (!file.is_open()) {
+// Version 1 payloads have no flags word between k and size.
+void EmpiricalDistribution::load_binary_payload(std::istream& file, const uint16_t version) {
+	int k = (int)BinaryFormat::read_integer(file, 4);
+	if (version >= 2) {
+		BinaryFormat::read_integer(file, 4);
+	}
+	uint64_t size = BinaryFormat::read_integer(file, 8);
+	if (size < 1 || size > (uint64_t)INT_MAX) {
+		throw 1;
+	}
+	if (size * sizeof(double) > BinaryFormat::bytes_left(file)) {
 		throw 0;
 	}
-	std::vector<double> result;
-	double x;
-	while (file >> x) {
-		result.push_back(x);
-	}
-	selection = result;
-	size = result.size();
-	k = (int)log2(size) + 1;
-	empirical_density = create_empirical_density(delta_calc(), create_intervals(delta_calc()));
+	std::vector<double> result(size);
+	BinaryFormat::read_doubles(file, result.data(), size);
+	storage = std::move(result);
+	mapping.reset();
+	kernel_density.reset();
+	summary.reset();
+	this->size = (int)size;
+	this->k = stored_intervals_number(k, this->size);
+	prepare_selection(true);
+	rebuild_density();
 }
\ No newline at end of file
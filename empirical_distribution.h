@@ -1,45 +1,92 @@
 #pragma once
 #include "distributions.h"
+#include "kernel_density.h"
+#include "mapped_file.h"
+#include "sample_store.h"
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
 
 class EmpiricalDistribution : public IDistribution, public IPresistend {
 public:
 	EmpiricalDistribution(const IDistribution& d, int n, int k);
 	EmpiricalDistribution(const EmpiricalDistribution& d);
-	EmpiricalDistribution(std::ifstream& file);
-	EmpiricalDistribution(const std::vector<double>& selection);
+	EmpiricalDistribution(EmpiricalDistribution&& d) noexcept;
+	EmpiricalDistribution(std::istream& file);
+	EmpiricalDistribution(const std::vector<double>& selection, bool ordered = true);
+	EmpiricalDistribution(std::vector<double>&& selection, bool ordered = true);
+	EmpiricalDistribution(SampleStore& store, double lower = -std::numeric_limits<double>::infinity(), double upper = std::numeric_limits<double>::infinity());
 	~EmpiricalDistribution();
 
+	static EmpiricalDistribution map_binary(const std::string& path);
+
 	double density(const double x) const override;
 	double expected_value() const override;
 	double dispersion() const override;
 	double kurtosis() const override;
 	double asymmetry() const override;
 	double rand_var() const override;
+	double distribution_function(const double x) const override;
+	double quantile(const double p) const override;
 
 	std::vector<double> generate_selection(const int n) const override;
-	std::vector<std::pair<double, double>> generate_graph_selection(const std::vector<double>& selection) const override;
+	void batch_density(std::span<const double> x, std::span<double> result) const override;
+	GraphSelection generate_graph_selection(std::span<const double> selection) const override;
 
 	EmpiricalDistribution& operator=(const EmpiricalDistribution& ed);
+	EmpiricalDistribution& operator=(EmpiricalDistribution&& ed) noexcept;
 
 	void set_intrevals_number(int k);
+	void set_kernel_density(Kernel kernel, Bandwidth rule = Bandwidth::silverman, int grid_size = 1024);
+	void set_histogram_density();
 
-	std::vector<double> get_selection() const;
-	std::vector<double> get_empirical_density() const;
+	std::span<const double> get_selection() const;
+	std::span<const double> get_empirical_density() const;
 	int get_size() const;
+	bool is_ordered() const;
+	bool is_mapped() const;
 	int get_intrevals_number() const;
+	const std::optional<KernelDensity>& get_kernel_density() const;
 
-	void load_from_file(std::ifstream& file) override;
-	void save_in_file(std::ofstream& file) override;
+	void load_from_file(std::istream& file) override;
+	void save_in_file(std::ostream& file) override;
+	void load_from_binary(std::istream& file) override;
+	void save_in_binary(std::ostream& file) override;
 private:
-	std::vector<double> selection;
+	std::vector<double> storage;
+	std::shared_ptr<const MappedFile> mapping;
+	std::span<const double> selection;
 	std::vector<double> empirical_density;
+	std::optional<KernelDensity> kernel_density;
+	// Moments read from the directory of a sample store the sample was fully loaded from.
+	std::optional<ChunkSummary> summary;
 	int size;
 	int k;
+	double lower;
+	double upper;
+	bool ordered;
+
+	static const int parallel_sort_threshold = 1 << 16;
+	static const size_t sample_header_size = 16;
+	static const uint32_t sorted_flag = 1;
 
+	static int default_intervals_number(const int size);
+	static int stored_intervals_number(const int k, const int size);
 	double delta_calc() const;
+	double central_sum(const int order, const double mean) const;
 	std::vector<double> create_intervals(const double delta) const;
 	double random_var() const;
-	std::vector<double> create_empirical_density(const double delta, std::vector<double> intervals) const;
+	std::vector<double> create_empirical_density(const double delta, const std::vector<double>& intervals) const;
+	void rebuild_density();
+	void prepare_selection(const bool ordered);
+	void bind_selection();
+
+	void load_binary_payload(std::istream& file, const uint16_t version);
+
+	EmpiricalDistribution() = default;
+
+	friend class FlatMixtureDistribution;
 	double qumulative_probability(const int i) const;
 	double top_bound() const;
 };
\ No newline at end of file
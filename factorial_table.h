@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cmath>
+
+// Factorials, log-factorials and normalized Laplace density coefficients
+// generated at compile time. Arguments outside the tables (non-integer,
+// beyond the largest finite double factorial 170! or beyond the tabulated
+// forms) fall back to lgamma, so any positive form is handled.
+class FactorialTable {
+public:
+	static const int max_factorial = 170;
+	static const int max_log_factorial = 1024;
+	static const int max_form = 64;
+
+	static constexpr std::array<double, max_factorial + 1> factorials = [] {
+		std::array<double, max_factorial + 1> result{};
+		result[0] = 1;
+		for (int i = 1; i <= max_factorial; ++i) {
+			result[i] = result[i - 1] * i;
+		}
+		return result;
+	}();
+
+	// std::log is not constexpr before C++26: i is reduced to m in [1, 2) and the atanh series of (m - 1) / (m + 1) is summed.
+	static constexpr std::array<double, max_log_factorial + 1> log_factorials = [] {
+		auto log = [](double x) {
+			int exponent = 0;
+			while (x >= 2) {
+				x /= 2;
+				++exponent;
+			}
+			double z = (x - 1) / (x + 1);
+			double term = z;
+			double sum = 0;
+			for (int k = 1; k < 60; k += 2) {
+				sum += term / k;
+				term *= z * z;
+			}
+			return exponent * 0.693147180559945309417232121458176568 + 2 * sum;
+		};
+		std::array<double, max_log_factorial + 1> result{};
+		for (int i = 1; i <= max_log_factorial; ++i) {
+			result[i] = result[i - 1] + log(i);
+		}
+		return result;
+	}();
+
+	// Row n - 1 holds c(n, j) = (n - 1 + j)! / ((n - 1 - j)! j! 2^j) / ((n - 1)! 2^n) for j < n,
+	// the coefficient of |x|^(n - 1 - j) exp(-|x|) in the standardized density of form n.
+	static constexpr std::array<std::array<double, max_form>, max_form> laplace_coefficients = [] {
+		auto power = [](int k) {
+			double result = 1;
+			for (int i = 0; i < k; ++i) {
+				result *= 2;
+			}
+			return result;
+		};
+		std::array<std::array<double, max_form>, max_form> result{};
+		for (int n = 1; n <= max_form; ++n) {
+			for (int j = 0; j < n; ++j) {
+				result[n - 1][j] = factorials[n - 1 + j] / (factorials[n - 1 - j] * factorials[j] * factorials[n - 1]) / power(n + j);
+			}
+		}
+		return result;
+	}();
+
+	static double factorial(const double n) {
+		if (n >= 0 && n <= max_factorial && n == (int)n) {
+			return factorials[(int)n];
+		}
+		return std::tgamma(n + 1);
+	}
+
+	static double log_factorial(const double n) {
+		if (n >= 0 && n <= max_log_factorial && n == (int)n) {
+			return log_factorials[(int)n];
+		}
+		return std::lgamma(n + 1);
+	}
+
+	static double laplace_coefficient(const double n, const int j) {
+		if (n >= 1 && n <= max_form && n == (int)n) {
+			return laplace_coefficients[(int)n - 1][j];
+		}
+		return std::exp(log_laplace_coefficient(n, j));
+	}
+
+	static double log_laplace_coefficient(const double n, const int j) {
+		if (n >= 1 && n <= max_form && n == (int)n) {
+			return std::log(laplace_coefficients[(int)n - 1][j]);
+		}
+		return log_factorial(n - 1 + j) - log_factorial(n - 1 - j) - log_factorial(j) - log_factorial(n - 1) - (n + j) * ln2;
+	}
+private:
+	static constexpr double ln2 = 0.693147180559945309417232121458176568;
+};
\ No newline at end of file
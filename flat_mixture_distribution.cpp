@@ -0,0 +1,269 @@
+#include "flat_mixture_distribution.h"
+#include "laplace_distribution.h"
+#include "empirical_distribution.h"
+#include "binary_format.h"
+#include "quantile_solver.h"
+#include <cmath>
+#include <limits>
+
+FlatMixtureDistribution::FlatMixtureDistribution(const std::vector<std::shared_ptr<IDistribution>>& components, const std::vector<double>& weights):
+	components(components), weights(weights) {
+	if (components.empty() || components.size() != weights.size()) {
+		throw 1;
+	}
+	normalize();
+}
+
+void FlatMixtureDistribution::normalize() {
+	double total = 0;
+	for (double w : weights) {
+		if (w < 0) {
+			throw 1;
+		}
+		total += w;
+	}
+	if (components.empty() || total <= 0) {
+		throw 1;
+	}
+	cumulative.clear();
+	double sum = 0;
+	for (double& w : weights) {
+		w /= total;
+		sum += w;
+		cumulative.push_back(sum);
+	}
+	cumulative.back() = 1;
+}
+
+// A mixture node sends weight (1 - p) to its first component and p to the second, as MixtureDistribution does.
+// The nesting depth and the weight count are bounded, so a corrupt file is rejected before it can exhaust
+// the stack or memory.
+void FlatMixtureDistribution::read_node(std::istream& file, const double weight, const int depth) {
+	if (depth > max_depth) {
+		throw 0;
+	}
+	uint16_t version;
+	switch (BinaryFormat::read_header(file, version)) {
+	case DistributionTag::laplace: {
+		auto leaf = std::make_shared<LaplaceDistribution>();
+		leaf->load_binary_payload(file);
+		components.push_back(leaf);
+		weights.push_back(weight);
+		break;
+	}
+	case DistributionTag::empirical: {
+		std::shared_ptr<EmpiricalDistribution> leaf(new EmpiricalDistribution());
+		leaf->load_binary_payload(file, version);
+		components.push_back(leaf);
+		weights.push_back(weight);
+		break;
+	}
+	case DistributionTag::mixture: {
+		double p = BinaryFormat::read_double(file);
+		if (!(p >= 0 && p <= 1)) {
+			throw 1;
+		}
+		read_node(file, weight * (1 - p), depth + 1);
+		read_node(file, weight * p, depth + 1);
+		break;
+	}
+	case DistributionTag::flat_mixture: {
+		uint64_t count = BinaryFormat::read_integer(file, 8);
+		if (count > max_components || count * sizeof(double) > BinaryFormat::bytes_left(file)) {
+			throw 0;
+		}
+		std::vector<double> node_weights(count);
+		BinaryFormat::read_doubles(file, node_weights.data(), count);
+		// Saved weights are normalised, and the negated test also rejects NaN.
+		for (double w : node_weights) {
+			if (!(w >= 0 && w <= 1)) {
+				throw 1;
+			}
+		}
+		for (double w : node_weights) {
+			read_node(file, weight * w, depth + 1);
+		}
+		break;
+	}
+	default:
+		throw 0;
+	}
+}
+
+FlatMixtureDistribution FlatMixtureDistribution::load_from_binary(std::istream& file) {
+	DISTRIBUTION_TRACE("persistence", "flat_mixture::load_from_binary");
+	if (!file) {
+		throw 0;
+	}
+	FlatMixtureDistribution result;
+	result.read_node(file, 1, 0);
+	result.normalize();
+	return result;
+}
+
+FlatMixtureDistribution FlatMixtureDistribution::load_from_path(const std::string& path) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		throw 0;
+	}
+	return load_from_binary(file);
+}
+
+void FlatMixtureDistribution::save_in_binary(std::ostream& file) const {
+	DISTRIBUTION_TRACE("persistence", "flat_mixture::save_in_binary");
+	BinaryFormat::write_header(file, DistributionTag::flat_mixture);
+	BinaryFormat::write_integer(file, weights.size(), 8);
+	BinaryFormat::write_doubles(file, weights.data(), weights.size());
+	for (const auto& d : components) {
+		auto persistent = std::dynamic_pointer_cast<IPresistend>(d);
+		if (!persistent) {
+			throw 1;
+		}
+		persistent->save_in_binary(file);
+	}
+}
+
+double FlatMixtureDistribution::density(const double x) const {
+	DISTRIBUTION_SCOPE("flat_mixture", density);
+	double sum = 0;
+	for (size_t i = 0; i < components.size(); ++i) {
+		sum += weights[i] * components[i]->density(x);
+	}
+	return sum;
+}
+
+double FlatMixtureDistribution::expected_value() const {
+	DISTRIBUTION_SCOPE("flat_mixture", moments);
+	double sum = 0;
+	for (size_t i = 0; i < components.size(); ++i) {
+		sum += weights[i] * components[i]->expected_value();
+	}
+	return sum;
+}
+
+// Central moments of the mixture from the mean, dispersion, asymmetry and excess kurtosis of every component.
+double FlatMixtureDistribution::central_moment(const int order) const {
+	double mean = expected_value();
+	double sum = 0;
+	for (size_t i = 0; i < components.size(); ++i) {
+		double delta = components[i]->expected_value() - mean;
+		double var = components[i]->dispersion();
+		double term = delta * delta + var;
+		if (order == 3) {
+			term = pow(delta, 3) + 3 * delta * var + pow(var, 1.5) * components[i]->asymmetry();
+		}
+		else if (order == 4) {
+			term = pow(delta, 4) + 6 * delta * delta * var + 4 * delta * pow(var, 1.5) * components[i]->asymmetry() +
+				var * var * (components[i]->kurtosis() + 3);
+		}
+		sum += weights[i] * term;
+	}
+	return sum;
+}
+
+double FlatMixtureDistribution::dispersion() const {
+	DISTRIBUTION_SCOPE("flat_mixture", moments);
+	return central_moment(2);
+}
+
+double FlatMixtureDistribution::asymmetry() const {
+	DISTRIBUTION_SCOPE("flat_mixture", moments);
+	return central_moment(3) / pow(dispersion(), 1.5);
+}
+
+double FlatMixtureDistribution::kurtosis() const {
+	DISTRIBUTION_SCOPE("flat_mixture", moments);
+	return central_moment(4) / pow(dispersion(), 2) - 3;
+}
+
+double FlatMixtureDistribution::random_var() const {
+	DISTRIBUTION_COUNT("flat_mixture", rng_draw);
+	double r;
+	do r = (double)rand() / RAND_MAX; while (r == 0 || r == 1);
+	return r;
+}
+
+double FlatMixtureDistribution::rand_var() const {
+	DISTRIBUTION_SCOPE("flat_mixture", rand_var);
+	int i = std::upper_bound(cumulative.begin(), cumulative.end(), random_var()) - cumulative.begin();
+	return components[std::min(i, (int)components.size() - 1)]->rand_var();
+}
+
+double FlatMixtureDistribution::distribution_function(const double x) const {
+	DISTRIBUTION_SCOPE("flat_mixture", distribution_function);
+	double sum = 0;
+	for (size_t i = 0; i < components.size(); ++i) {
+		sum += weights[i] * components[i]->distribution_function(x);
+	}
+	return sum;
+}
+
+// As for MixtureDistribution, the smallest and largest component quantiles bracket the root.
+double FlatMixtureDistribution::quantile(const double p) const {
+	DISTRIBUTION_SCOPE("flat_mixture", quantile);
+	if (p < 0 || p > 1) {
+		throw 1;
+	}
+	double lower = std::numeric_limits<double>::infinity(), upper = -lower;
+	for (size_t i = 0; i < components.size(); ++i) {
+		if (weights[i] > 0) {
+			double q = components[i]->quantile(p);
+			lower = std::min(lower, q);
+			upper = std::max(upper, q);
+		}
+	}
+	if (lower == upper || p == 0 || p == 1) {
+		return p == 1 ? upper : lower;
+	}
+	return QuantileSolver::solve(p, lower, upper,
+		[this](const double x) { return distribution_function(x); },
+		[this](const double x) { return density(x); });
+}
+
+std::vector<double> FlatMixtureDistribution::generate_selection(const int n) const {
+	DISTRIBUTION_SCOPE("flat_mixture", generate_selection);
+	DISTRIBUTION_TRACE("sampling", "flat_mixture::generate_selection");
+	std::vector<double> sample;
+	sample.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		sample.push_back(rand_var());
+	}
+	{
+		DISTRIBUTION_TRACE("sorting", "flat_mixture::sort_selection");
+		sort(sample.begin(), sample.end());
+	}
+	return sample;
+}
+
+void FlatMixtureDistribution::batch_density(std::span<const double> x, std::span<double> result) const {
+	DISTRIBUTION_SCOPE("flat_mixture", batch_density);
+	if (result.size() < x.size()) {
+		throw 1;
+	}
+	std::vector<double> component_density(x.size());
+	std::fill(result.begin(), result.end(), 0.0);
+	for (size_t j = 0; j < components.size(); ++j) {
+		components[j]->batch_density(x, component_density);
+		for (size_t i = 0; i < x.size(); ++i) {
+			result[i] += weights[j] * component_density[i];
+		}
+	}
+}
+
+GraphSelection FlatMixtureDistribution::generate_graph_selection(std::span<const double> selection) const {
+	GraphSelection result{ selection, std::vector<double>(selection.size()) };
+	batch_density(selection, result.density);
+	return result;
+}
+
+int FlatMixtureDistribution::get_components_number() const {
+	return components.size();
+}
+
+double FlatMixtureDistribution::get_weight(const int i) const {
+	return weights.at(i);
+}
+
+const IDistribution& FlatMixtureDistribution::component(const int i) const {
+	return *components.at(i);
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include "distributions.h"
+#include <memory>
+
+// Mixture of any number of components with explicit weights. Built from the
+// tagged binary format, it loads a whole MixtureDistribution tree of any
+// nesting in one pass without knowing the template types: every leaf becomes a
+// component weighted by the product of the mixing probabilities on its path.
+class FlatMixtureDistribution : public IDistribution {
+public:
+	FlatMixtureDistribution(const std::vector<std::shared_ptr<IDistribution>>& components, const std::vector<double>& weights);
+
+	static FlatMixtureDistribution load_from_binary(std::istream& file);
+	static FlatMixtureDistribution load_from_path(const std::string& path);
+	void save_in_binary(std::ostream& file) const;
+
+	double density(const double x) const override;
+	double expected_value() const override;
+	double dispersion() const override;
+	double kurtosis() const override;
+	double asymmetry() const override;
+	double rand_var() const override;
+	double distribution_function(const double x) const override;
+	double quantile(const double p) const override;
+	std::vector<double> generate_selection(const int n) const override;
+	void batch_density(std::span<const double> x, std::span<double> result) const override;
+	GraphSelection generate_graph_selection(std::span<const double> selection) const override;
+
+	int get_components_number() const;
+	double get_weight(const int i) const;
+	const IDistribution& component(const int i) const;
+private:
+	std::vector<std::shared_ptr<IDistribution>> components;
+	std::vector<double> weights;
+	std::vector<double> cumulative;
+
+	FlatMixtureDistribution() = default;
+
+	static const int max_depth = 64;
+	static const uint64_t max_components = 1 << 24;
+
+	void read_node(std::istream& file, const double weight, const int depth);
+	void normalize();
+	double central_moment(const int order) const;
+	double random_var() const;
+};
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "kernel_density.h"
+#include "tracing.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+
+static const double pi = 3.14159265358979323846;
+
+static void fft(std::vector<std::complex<double>>& a, const bool inverse) {
+	const size_t n = a.size();
+	for (size_t i = 1, j = 0; i < n; ++i) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			std::swap(a[i], a[j]);
+		}
+	}
+	for (size_t len = 2; len <= n; len <<= 1) {
+		double angle = 2 * pi / len * (inverse ? 1 : -1);
+		std::complex<double> wlen(cos(angle), sin(angle));
+		for (size_t i = 0; i < n; i += len) {
+			std::complex<double> w(1);
+			for (size_t j = 0; j < len / 2; ++j) {
+				std::complex<double> u = a[i + j];
+				std::complex<double> v = a[i + j + len / 2] * w;
+				a[i + j] = u + v;
+				a[i + j + len / 2] = u - v;
+				w *= wlen;
+			}
+		}
+	}
+	if (inverse) {
+		for (auto& x : a) {
+			x /= (double)n;
+		}
+	}
+}
+
+// The interquartile range is only read off an ordered selection, otherwise the Silverman rule uses the standard deviation alone.
+double KernelDensity::bandwidth(std::span<const double> selection, Bandwidth rule) {
+	const size_t size = selection.size();
+	if (size < 2) {
+		throw 1;
+	}
+	double mean = 0;
+	for (double x : selection) {
+		mean += x;
+	}
+	mean /= size;
+	double sd = 0;
+	for (double x : selection) {
+		sd += (x - mean) * (x - mean);
+	}
+	sd = sqrt(sd / (size - 1));
+	double factor = pow((double)size, -0.2);
+	if (rule == Bandwidth::scott) {
+		return 1.06 * sd * factor;
+	}
+	double iqr = std::is_sorted(selection.begin(), selection.end()) ? selection[size * 3 / 4] - selection[size / 4] : 0;
+	double spread = iqr > 0 ? std::min(sd, iqr / 1.34) : sd;
+	return 0.9 * spread * factor;
+}
+
+// The Epanechnikov kernel is scaled to unit variance, so the same bandwidth gives comparable smoothing for both kernels.
+double KernelDensity::support() const {
+	return kernel == Kernel::gaussian ? 4 * h : sqrt(5.0) * h;
+}
+
+double KernelDensity::kernel_value(const double u) const {
+	if (kernel == Kernel::gaussian) {
+		return exp(-u * u / 2) / sqrt(2 * pi);
+	}
+	double v = u / sqrt(5.0);
+	return std::abs(v) < 1 ? 0.75 * (1 - v * v) / sqrt(5.0) : 0;
+}
+
+// Linear binning of the sample on the grid followed by a single FFT convolution with the kernel,
+// O(n + g log g) instead of evaluating the kernel sum at every grid point.
+KernelDensity::KernelDensity(std::span<const double> selection, Kernel kernel, Bandwidth rule, int grid_size):
+	kernel(kernel), h(bandwidth(selection, rule)) {
+	DISTRIBUTION_TRACE("construction", "kernel_density::build");
+	if (grid_size < 2 || h <= 0) {
+		throw 1;
+	}
+	const size_t size = selection.size();
+	auto bounds = std::minmax_element(selection.begin(), selection.end());
+	begin = *bounds.first - support();
+	step = (*bounds.second + support() - begin) / (grid_size - 1);
+
+	std::vector<double> counts(grid_size, 0);
+	for (double x : selection) {
+		double t = (x - begin) / step;
+		int i = std::min((int)t, grid_size - 2);
+		double frac = t - i;
+		counts[i] += 1 - frac;
+		counts[i + 1] += frac;
+	}
+
+	int radius = std::min(grid_size - 1, (int)ceil(support() / step));
+	size_t padded = 1;
+	while (padded < (size_t)(grid_size + radius)) {
+		padded <<= 1;
+	}
+	std::vector<std::complex<double>> data(padded), weights(padded);
+	for (int i = 0; i < grid_size; ++i) {
+		data[i] = counts[i];
+	}
+	for (int i = 0; i <= radius; ++i) {
+		double w = kernel_value(i * step / h) / (size * h);
+		weights[i] = w;
+		if (i > 0) {
+			weights[padded - i] = w;
+		}
+	}
+	fft(data, false);
+	fft(weights, false);
+	for (size_t i = 0; i < padded; ++i) {
+		data[i] *= weights[i];
+	}
+	fft(data, true);
+
+	grid.resize(grid_size);
+	for (int i = 0; i < grid_size; ++i) {
+		grid[i] = std::max(0.0, data[i].real());
+	}
+	cumulative.assign(grid_size, 0);
+	for (int i = 1; i < grid_size; ++i) {
+		cumulative[i] = cumulative[i - 1] + step * (grid[i - 1] + grid[i]) / 2;
+	}
+}
+
+double KernelDensity::density(const double x) const {
+	double t = (x - begin) / step;
+	if (t < 0 || t > grid.size() - 1) {
+		return 0;
+	}
+	size_t i = std::min((size_t)t, grid.size() - 2);
+	double frac = t - i;
+	return grid[i] * (1 - frac) + grid[i + 1] * frac;
+}
+
+// Exact integral of the linearly interpolated grid, normalized by its total mass.
+double KernelDensity::distribution_function(const double x) const {
+	double t = (x - begin) / step;
+	if (t <= 0) {
+		return 0;
+	}
+	if (t >= grid.size() - 1) {
+		return 1;
+	}
+	size_t i = std::min((size_t)t, grid.size() - 2);
+	double frac = t - i;
+	double mass = cumulative[i] + step * frac * (grid[i] + (grid[i + 1] - grid[i]) * frac / 2);
+	return mass / cumulative.back();
+}
+
+// The mass inside a cell is quadratic in the offset; the root is taken in the form that stays finite for flat cells.
+double KernelDensity::quantile(const double p) const {
+	if (p < 0 || p > 1) {
+		throw 1;
+	}
+	double mass = p * cumulative.back();
+	size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), mass) - cumulative.begin();
+	if (i >= grid.size()) {
+		return begin + step * (grid.size() - 1);
+	}
+	i = i == 0 ? 0 : i - 1;
+	double r = (mass - cumulative[i]) / step;
+	double slope = grid[i + 1] - grid[i];
+	double root = std::sqrt(std::max(0.0, grid[i] * grid[i] + 2 * slope * r));
+	double frac = grid[i] + root > 0 ? std::min(1.0, 2 * r / (grid[i] + root)) : 0;
+	return begin + step * (i + frac);
+}
+
+double KernelDensity::random_var() const {
+	double r;
+	do r = (double)rand() / RAND_MAX; while (r == 0 || r == 1);
+	return r;
+}
+
+// Smoothed bootstrap: a sample point shifted by a draw from the kernel.
+double KernelDensity::rand_var(const double center) const {
+	if (kernel == Kernel::gaussian) {
+		return center + h * sqrt(-2 * log(random_var())) * cos(2 * pi * random_var());
+	}
+	double u1 = 2 * random_var() - 1, u2 = 2 * random_var() - 1, u3 = 2 * random_var() - 1;
+	double u = (std::abs(u3) >= std::abs(u2) && std::abs(u3) >= std::abs(u1)) ? u2 : u3;
+	return center + h * sqrt(5.0) * u;
+}
+
+Kernel KernelDensity::get_kernel() const {
+	return kernel;
+}
+
+double KernelDensity::get_bandwidth() const {
+	return h;
+}
+
+const std::vector<double>& KernelDensity::get_grid() const {
+	return grid;
+}
+
+double KernelDensity::get_grid_begin() const {
+	return begin;
+}
+
+double KernelDensity::get_grid_step() const {
+	return step;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <span>
+#include <vector>
+
+enum class Kernel { gaussian, epanechnikov };
+enum class Bandwidth { silverman, scott };
+
+class KernelDensity {
+public:
+	KernelDensity(std::span<const double> selection, Kernel kernel, Bandwidth rule, int grid_size = 1024);
+
+	double density(const double x) const;
+	double rand_var(const double center) const;
+	double distribution_function(const double x) const;
+	double quantile(const double p) const;
+
+	Kernel get_kernel() const;
+	double get_bandwidth() const;
+	const std::vector<double>& get_grid() const;
+	double get_grid_begin() const;
+	double get_grid_step() const;
+
+	static double bandwidth(std::span<const double> selection, Bandwidth rule);
+private:
+	Kernel kernel;
+	double h;
+	double begin;
+	double step;
+	std::vector<double> grid;
+	std::vector<double> cumulative;
+
+	double support() const;
+	double kernel_value(const double u) const;
+	double random_var() const;
+};
\ No newline at end of file
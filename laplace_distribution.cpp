@@ -1,4 +1,11 @@
 #include "laplace_distribution.h"
+#include "binary_format.h"
+#include "text_format.h"
+#include "ziggurat.h"
+#include "quantile_solver.h"
+#include <execution>
+#include <limits>
+#include <numeric>
 
 LaplaceDistribution::LaplaceDistribution():
 	n(1), mu(0), lambda(1){}
@@ -6,62 +13,133 @@ LaplaceDistribution::LaplaceDistribution():
 LaplaceDistribution::LaplaceDistribution(double _n, double _mu, double _lambda) :
 	n(_n > 0 ? _n : throw 1), lambda(_lambda > 0 ? _lambda : throw 1), mu(_mu) {}
 
-LaplaceDistribution::LaplaceDistribution(std::ifstream& file) {
-	double n, mu, lambda;
-	file.open("params.txt");
-	if (!file.is_open()) {
-		throw 0;
-	}
-	file >> n >> mu >> lambda;
-	file.close();
-	LaplaceDistribution(n, mu, lambda);
+LaplaceDistribution::LaplaceDistribution(std::istream& file) {
+	load_from_file(file);
 }
 
 double LaplaceDistribution::standartization(const double x, const double lambda, const double mu) const {
 	return (x - mu) / lambda;
 }
 
-double LaplaceDistribution::fact(const double n) const {
-	if (n == 0 || n == 1) {
-		return 1;
-	}
-	else {
-		return n * fact(n - 1);
-	}
-}
-
 double LaplaceDistribution::random_var() const {
+	DISTRIBUTION_COUNT("laplace", rng_draw);
 	double r;
 	do r = (double)rand() / RAND_MAX; while (r == 0 || r == 1);
 	return r;
 }
 
+double LaplaceDistribution::ziggurat_var() const {
+	DISTRIBUTION_COUNT("laplace", rng_draw);
+	return ZigguratExponential::signed_sample();
+}
+
 double LaplaceDistribution::density(const double x) const {
-	double xstd = standartization(x, lambda, mu);
+	DISTRIBUTION_SCOPE("laplace", density);
+	return standard_density(standartization(x, lambda, mu)) / lambda;
+}
+
+double LaplaceDistribution::standard_density(const double xstd) const {
+	if (int form = LaplaceKernels::fixed_form(n)) {
+		return LaplaceKernels::dispatch(form, [xstd](auto N) { return LaplaceKernel<N>::density(xstd); });
+	}
+	// Terms are summed in log space, where neither the power of |x| nor the factorials of a large form overflow.
+	double a = std::abs(xstd);
+	double log_a = log(a);
 	double dist_sum = 0;
 	for (int j = 0; j < n; ++j) {
-		dist_sum += (fact(n - 1 + j) * pow(abs(xstd), (n - j - 1))) / (fact(n - j - 1) * fact(j) * pow(2, j));
+		double power = n - j - 1;
+		dist_sum += exp(FactorialTable::log_laplace_coefficient(n, j) + (power == 0 ? 0 : power * log_a) - a);
+	}
+	return dist_sum;
+}
+
+// P(X < -a) of the standardized variate. Each term |x|^m exp(-|x|) of the density integrates to the upper
+// incomplete gamma function m! exp(-a) (1 + a + ... + a^m / m!); the partial exponential series grows
+// with the power and, like the density, is combined with the coefficients in log space.
+double LaplaceDistribution::tail_probability(const double a) const {
+	if (n == 1) {
+		return exp(-a) / 2;
+	}
+	double series = 0, term = 1, sum = 0;
+	for (int power = 0; power < n; ++power) {
+		series += term;
+		sum += exp(FactorialTable::log_laplace_coefficient(n, n - 1 - power) + FactorialTable::log_factorial(power) + log(series) - a);
+		term *= a / (power + 1);
+	}
+	return sum;
+}
+
+// Closed form for integer forms; the sum of the density has no finite antiderivative otherwise.
+double LaplaceDistribution::distribution_function(const double x) const {
+	DISTRIBUTION_SCOPE("laplace", distribution_function);
+	if (n != std::floor(n)) {
+		throw 1;
+	}
+	double xstd = standartization(x, lambda, mu);
+	return xstd < 0 ? tail_probability(-xstd) : 1 - tail_probability(xstd);
+}
+
+// The classical form inverts in closed form. Other forms solve for the lower tail, where the probability
+// keeps its relative precision, and mirror the root for p above the median.
+double LaplaceDistribution::quantile(const double p) const {
+	DISTRIBUTION_SCOPE("laplace", quantile);
+	if (p < 0 || p > 1 || n != std::floor(n)) {
+		throw 1;
+	}
+	if (p == 0 || p == 1) {
+		return p == 0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+	}
+	if (n == 1) {
+		// Unlike the sampling transform, 2p is not formed as 1 - 2|p - 0.5|, which would cancel in the far tail.
+		return (p < 0.5 ? log(2 * p) : -log(2 * (1 - p))) * lambda + mu;
+	}
+	double q = std::min(p, 1 - p);
+	if (q == 0.5) {
+		return mu;
 	}
-	return exp(-abs(xstd)) * dist_sum / (fact(n - 1) * pow(2, n) * lambda);
+	double lower = -1;
+	while (tail_probability(-lower) > q) {
+		lower *= 2;
+	}
+	double xstd = QuantileSolver::solve(q, lower, 0.0,
+		[this](const double z) { return tail_probability(-z); },
+		[this](const double z) { return standard_density(z); });
+	return (p < 0.5 ? xstd : -xstd) * lambda + mu;
 }
 
 double LaplaceDistribution::expected_value() const {
+	DISTRIBUTION_SCOPE("laplace", moments);
 	return mu;
 }
 
 double LaplaceDistribution::dispersion() const {
+	DISTRIBUTION_SCOPE("laplace", moments);
 	return 2 * n * lambda * lambda;
 }
 
 double LaplaceDistribution::asymmetry() const {
+	DISTRIBUTION_SCOPE("laplace", moments);
 	return 0;
 }
 
 double LaplaceDistribution::kurtosis() const {
+	DISTRIBUTION_SCOPE("laplace", moments);
 	return 3 / n;
 }
 
 double LaplaceDistribution::rand_var() const {
+	DISTRIBUTION_SCOPE("laplace", rand_var);
+	if (sampler == LaplaceSampler::ziggurat) {
+		// The n-fold variate is the sum of n standard Laplace variates, each a signed exponential.
+		double sum = 0;
+		for (int i = 0; i < n; ++i) {
+			sum += ziggurat_var();
+		}
+		return sum * lambda + mu;
+	}
+	if (int form = LaplaceKernels::fixed_form(n)) {
+		return LaplaceKernels::dispatch(form, [this](auto N) { return LaplaceKernel<N>::sample([this] { return random_var(); }); }) * lambda + mu;
+	}
 	double mult1 = 1, mult2 = 1;
 	for (int i = 0; i < n; ++i) {
 		double r = random_var();
@@ -93,6 +171,10 @@ void LaplaceDistribution::set_scale(const double lambda) {
 	this->lambda = lambda;
 }
 
+void LaplaceDistribution::set_sampler(const LaplaceSampler sampler) {
+	this->sampler = sampler;
+}
+
 double LaplaceDistribution::get_form() const {
 	return n;
 }
@@ -105,37 +187,151 @@ double LaplaceDistribution::get_scale() const {
 	return lambda;
 }
 
+LaplaceSampler LaplaceDistribution::get_sampler() const {
+	return sampler;
+}
+
+// Median of the sample; the selection is partially reordered in place instead of being copied and sorted.
+double LaplaceDistribution::fit_shift(std::vector<double>& selection) {
+	if (selection.empty()) {
+		throw 1;
+	}
+	auto middle = selection.begin() + selection.size() / 2;
+	std::nth_element(std::execution::par_unseq, selection.begin(), middle, selection.end());
+	if (selection.size() % 2 == 1) {
+		return *middle;
+	}
+	return (*std::max_element(std::execution::par_unseq, selection.begin(), middle) + *middle) / 2;
+}
+
+// Mean absolute deviation about mu, the maximum likelihood estimate of lambda for n = 1.
+double LaplaceDistribution::fit_scale(const std::vector<double>& selection, const double mu) {
+	if (selection.empty()) {
+		throw 1;
+	}
+	double sum = std::transform_reduce(std::execution::par_unseq, selection.begin(), selection.end(), 0.0, std::plus<>(),
+		[mu](const double x) { return std::abs(x - mu); });
+	return sum / selection.size();
+}
+
+// Method of moments on the excess kurtosis 3 / n, rounded to the nearest integer form.
+double LaplaceDistribution::fit_form(const std::vector<double>& selection) {
+	if (selection.size() < 2) {
+		throw 1;
+	}
+	double size = selection.size();
+	double mean = std::reduce(std::execution::par_unseq, selection.begin(), selection.end(), 0.0) / size;
+	auto moments = std::transform_reduce(std::execution::par_unseq, selection.begin(), selection.end(), std::make_pair(0.0, 0.0),
+		[](const std::pair<double, double>& a, const std::pair<double, double>& b) { return std::make_pair(a.first + b.first, a.second + b.second); },
+		[mean](const double x) { double d2 = (x - mean) * (x - mean); return std::make_pair(d2, d2 * d2); });
+	double m2 = moments.first / size;
+	double m4 = moments.second / size;
+	if (m2 == 0) {
+		throw 1;
+	}
+	double excess = m4 / (m2 * m2) - 3;
+	if (excess <= 0) {
+		throw 1;
+	}
+	return std::max(1.0, std::round(3 / excess));
+}
+
+LaplaceDistribution LaplaceDistribution::fit(std::vector<double>& selection) {
+	double n = fit_form(selection);
+	double mu = fit_shift(selection);
+	if (n == 1) {
+		return LaplaceDistribution(n, mu, fit_scale(selection, mu));
+	}
+	double size = selection.size();
+	double dispersion = std::transform_reduce(std::execution::par_unseq, selection.begin(), selection.end(), 0.0, std::plus<>(),
+		[mu](const double x) { return (x - mu) * (x - mu); }) / size;
+	return LaplaceDistribution(n, mu, std::sqrt(dispersion / (2 * n)));
+}
+
 std::vector<double> LaplaceDistribution::generate_selection(const int n) const {
+	DISTRIBUTION_SCOPE("laplace", generate_selection);
+	DISTRIBUTION_TRACE("sampling", "laplace::generate_selection");
 	std::vector<double> sample;
-	for (int i = 0; i < n; ++i) {
-		sample.push_back(rand_var());
+	if (sampler == LaplaceSampler::inverse_transform && LaplaceKernels::fixed_form(this->n) == 1) {
+		// Classical case: all uniforms are drawn first, then transformed in one vectorizable pass.
+		sample.resize(n);
+		for (int i = 0; i < n; ++i) {
+			sample[i] = random_var();
+		}
+		LaplaceKernel<1>::batch_inverse_transform(sample, mu, lambda);
+	}
+	else {
+		for (int i = 0; i < n; ++i) {
+			sample.push_back(rand_var());
+		}
+	}
+	{
+		DISTRIBUTION_TRACE("sorting", "laplace::sort_selection");
+		sort(sample.begin(), sample.end());
 	}
-	sort(sample.begin(), sample.end());
 	return sample;
 }
 
-std::vector<std::pair<double, double>> LaplaceDistribution::generate_graph_selection(const std::vector<double>& selection) const {
-	std::vector<std::pair<double, double>> result;
-	for (int i = 0; i < selection.size(); ++i) {
-		result.push_back(std::make_pair(selection[i], density(selection[i])));
+void LaplaceDistribution::batch_density(std::span<const double> x, std::span<double> result) const {
+	DISTRIBUTION_SCOPE("laplace", batch_density);
+	if (result.size() < x.size()) {
+		throw 1;
 	}
+	if (int form = LaplaceKernels::fixed_form(n)) {
+		LaplaceKernels::dispatch(form, [&](auto N) { LaplaceKernel<N>::batch_density(x, mu, lambda, result); });
+		return;
+	}
+	for (size_t i = 0; i < x.size(); ++i) {
+		result[i] = density(x[i]);
+	}
+}
+
+GraphSelection LaplaceDistribution::generate_graph_selection(std::span<const double> selection) const {
+	GraphSelection result{ selection, std::vector<double>(selection.size()) };
+	batch_density(selection, result.density);
 	return result;
 }
 
-void LaplaceDistribution::save_in_file(std::ofstream& file){
-	file << n << std::endl << mu << std::endl << lambda << std::endl;
+void LaplaceDistribution::save_in_file(std::ostream& file){
+	TextFormat::write_double(file, n);
+	TextFormat::write_double(file, mu);
+	TextFormat::write_double(file, lambda);
 }
 
-void LaplaceDistribution::load_from_file(std::ifstream& file) {
+void LaplaceDistribution::load_from_file(std::istream& file) {
 	double n, mu, lambda;
-	if (!file.is_open()) {
+	if (!(file >> n >> mu >> lambda)) {
 		throw 0;
 	}
-	file >> n >> mu >> lambda;
 	if (n <= 0 || lambda <= 0) {
 		throw 1;
 	}
 	this->n = n;
 	this->mu = mu;
 	this->lambda = lambda;
+}
+
+void LaplaceDistribution::save_in_binary(std::ostream& file) {
+	BinaryFormat::write_header(file, DistributionTag::laplace);
+	double params[] = { n, mu, lambda };
+	BinaryFormat::write_doubles(file, params, 3);
+}
+
+void LaplaceDistribution::load_from_binary(std::istream& file) {
+	if (!file) {
+		throw 0;
+	}
+	BinaryFormat::expect_header(file, DistributionTag::laplace);
+	load_binary_payload(file);
+}
+
+void LaplaceDistribution::load_binary_payload(std::istream& file) {
+	double params[3];
+	BinaryFormat::read_doubles(file, params, 3);
+	if (params[0] <= 0 || params[2] <= 0) {
+		throw 1;
+	}
+	n = params[0];
+	mu = params[1];
+	lambda = params[2];
 }
\ No newline at end of file
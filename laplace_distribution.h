@@ -1,11 +1,16 @@
 #pragma once
 #include "distributions.h"
+#include "laplace_kernel.h"
+
+// Source of variates: the inverse transform / product of rand() uniforms, or a
+// ziggurat sum of signed exponentials that avoids log on the common path.
+enum class LaplaceSampler { inverse_transform, ziggurat };
 
 class LaplaceDistribution : public IDistribution, public IPresistend {
 public:
 	LaplaceDistribution();
 	LaplaceDistribution(double n, double mu, double lambda);
-	LaplaceDistribution(std::ifstream& file);
+	LaplaceDistribution(std::istream& file);
 
 	double density(const double x) const override;
 	double expected_value() const override;
@@ -13,26 +18,44 @@ public:
 	double kurtosis() const override;
 	double asymmetry() const override;
 	double rand_var() const override;
+	double distribution_function(const double x) const override;
+	double quantile(const double p) const override;
 
 	std::vector<double> generate_selection(const int n) const override;
-	std::vector<std::pair<double, double>> generate_graph_selection(const std::vector<double>& selection) const override;
+	void batch_density(std::span<const double> x, std::span<double> result) const override;
+	GraphSelection generate_graph_selection(std::span<const double> selection) const override;
 
 	void set_form(const double n);
 	void set_shift(const double mu);
 	void set_scale(const double lambda);
+	void set_sampler(const LaplaceSampler sampler);
 
 	double get_form() const;
 	double get_shift() const;
 	double get_scale() const;
+	LaplaceSampler get_sampler() const;
+
+	static double fit_shift(std::vector<double>& selection);
+	static double fit_scale(const std::vector<double>& selection, const double mu);
+	static double fit_form(const std::vector<double>& selection);
+	static LaplaceDistribution fit(std::vector<double>& selection);
 
-	void load_from_file(std::ifstream& file) override;
-	void save_in_file(std::ofstream& file) override;
+	void load_from_file(std::istream& file) override;
+	void save_in_file(std::ostream& file) override;
+	void load_from_binary(std::istream& file) override;
+	void save_in_binary(std::ostream& file) override;
 private:
 	double n;
 	double mu;
 	double lambda;
+	LaplaceSampler sampler = LaplaceSampler::inverse_transform;
 
 	double standartization(const double x, const double lambda, const double mu) const;
+	double standard_density(const double xstd) const;
+	double tail_probability(const double a) const;
 	double random_var() const;
-	double fact(const double n) const;
+	double ziggurat_var() const;
+	void load_binary_payload(std::istream& file);
+
+	friend class FlatMixtureDistribution;
 };
\ No newline at end of file
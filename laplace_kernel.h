@@ -0,0 +1,132 @@
+#pragma once
+#include "factorial_table.h"
+#include "vector_math.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <utility>
+
+// Density and sampling kernels of the Laplace form for a fixed integer form N.
+// The density of the standardized variate is exp(-|x|) times a polynomial of
+// degree N - 1 in |x|; its coefficients are computed at compile time and the
+// Horner evaluation and the product of uniforms are unrolled for the given N.
+// LaplaceDistribution dispatches to these kernels for integer forms up to
+// max_form and keeps its runtime loops for any other n.
+template<int N>
+class LaplaceKernel {
+	static_assert(N >= 1, "the form of the Laplace distribution is positive");
+public:
+	// Coefficient of |x|^(N - 1 - j), taken from the row of FactorialTable::laplace_coefficients.
+	static constexpr std::array<double, N> coefficients = [] {
+		std::array<double, N> result{};
+		for (int j = 0; j < N; ++j) {
+			result[j] = FactorialTable::laplace_coefficients[N - 1][j];
+		}
+		return result;
+	}();
+
+	static double density(const double xstd) {
+		const double a = std::abs(xstd);
+		double polynomial = coefficients[0];
+		[&]<size_t... I>(std::index_sequence<I...>) {
+			((polynomial = polynomial * a + coefficients[I + 1]), ...);
+		}(std::make_index_sequence<N - 1>());
+		return std::exp(-a) * polynomial;
+	}
+
+	// The batch goes through the vector math kernels block by block: |x|, exp(-|x|) and the polynomial.
+	static void batch_density(std::span<const double> x, const double mu, const double lambda, std::span<double> result) {
+		const size_t block = 256;
+		double a[block], e[block];
+		for (size_t i = 0; i < x.size(); i += block) {
+			const size_t size = std::min(block, x.size() - i);
+			for (size_t j = 0; j < size; ++j) {
+				a[j] = (x[i + j] - mu) / lambda;
+			}
+			VectorMath::abs(std::span<const double>(a, size), std::span<double>(a, size));
+			for (size_t j = 0; j < size; ++j) {
+				e[j] = -a[j];
+			}
+			VectorMath::exp(std::span<const double>(e, size), std::span<double>(e, size));
+			std::span<double> out = result.subspan(i, size);
+			VectorMath::polynomial(std::span<const double>(a, size), coefficients, out);
+			for (size_t j = 0; j < size; ++j) {
+				out[j] *= e[j] / lambda;
+			}
+		}
+	}
+
+	// Same scheme as LaplaceDistribution::rand_var: N uniforms split into the two products.
+	// For N = 1 this is the single-uniform inverse transform.
+	template<class Uniform>
+	static double sample(Uniform&& uniform) {
+		if constexpr (N == 1) {
+			return inverse_transform(uniform());
+		}
+		else {
+			double mult1 = 1, mult2 = 1;
+			[&]<size_t... I>(std::index_sequence<I...>) {
+				(((void)I, draw(uniform(), mult1, mult2)), ...);
+			}(std::make_index_sequence<N>());
+			return std::log(mult1 / mult2);
+		}
+	}
+
+	// Branch-free inverse of the classical (N = 1) distribution function: log(2u) below the median, -log(2(1 - u)) above it.
+	static double inverse_transform(const double u) requires (N == 1) {
+		const double d = u - 0.5;
+		return std::copysign(std::log(1 - 2 * std::abs(d)), d);
+	}
+
+	// Turns a batch of uniforms into variates with the given shift and scale in place, with the logarithms taken by the vector math kernels.
+	static void batch_inverse_transform(std::span<double> u, const double mu, const double lambda) requires (N == 1) {
+		const size_t block = 256;
+		double t[block];
+		for (size_t i = 0; i < u.size(); i += block) {
+			const size_t size = std::min(block, u.size() - i);
+			std::span<double> out = u.subspan(i, size);
+			for (size_t j = 0; j < size; ++j) {
+				t[j] = 1 - 2 * std::abs(out[j] - 0.5);
+			}
+			VectorMath::log(std::span<const double>(t, size), std::span<double>(t, size));
+			for (size_t j = 0; j < size; ++j) {
+				out[j] = std::copysign(t[j], out[j] - 0.5) * lambda + mu;
+			}
+		}
+	}
+private:
+	static void draw(const double r, double& mult1, double& mult2) {
+		if (r <= 0.5) {
+			mult1 *= 2 * r;
+		}
+		else {
+			mult2 *= 2 * (1 - r);
+		}
+	}
+};
+
+class LaplaceKernels {
+public:
+	static const int max_form = 8;
+
+	// Form as a kernel index, or 0 when n is not an integer in [1, max_form].
+	static int fixed_form(const double n) {
+		return n >= 1 && n <= max_form && n == (int)n ? (int)n : 0;
+	}
+
+	// Calls f with std::integral_constant<int, form> for form in [1, max_form].
+	template<class F>
+	static decltype(auto) dispatch(const int form, F&& f) {
+		switch (form) {
+		case 1: return f(std::integral_constant<int, 1>());
+		case 2: return f(std::integral_constant<int, 2>());
+		case 3: return f(std::integral_constant<int, 3>());
+		case 4: return f(std::integral_constant<int, 4>());
+		case 5: return f(std::integral_constant<int, 5>());
+		case 6: return f(std::integral_constant<int, 6>());
+		case 7: return f(std::integral_constant<int, 7>());
+		default: return f(std::integral_constant<int, 8>());
+		}
+	}
+};
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "laplace_distribution.h"
 #include "empirical_distribution.h"
 #include "mixture_distribution.cpp"
+#include "async_writer.h"
+#include "tracing.h"
 #include "catch.hpp"
 using namespace std;
 
@@ -30,9 +32,7 @@ int main(int argc, char** argv) {
 		auto selection = md.generate_selection(1000);
 		auto graph1 = md.generate_graph_selection(selection);
 		EmpiricalDistribution ed(selection);
-		auto graph2 = ed.generate_graph_selection(selection);
 		EmpiricalDistribution ed2(ed, 1000, 1);
-		auto graph3 = ed2.generate_graph_selection(selection);
 
 		cout << ": n1 = " << md.component1().component1().get_form() << ", mu1 = " << md.component1().component1().get_shift() << ", lambda1 = " << md.component1().component1().get_scale()<<
 			"\nn2 = " << md.component1().component2().get_form() << ", mu2 = " << md.component1().component2().get_shift() << ", lambda2 = " << md.component1().component2().get_scale() <<
@@ -44,10 +44,14 @@ int main(int argc, char** argv) {
 
 
 
-		for (int i = 0; i < 1000; ++i) {
-			file1 << graph2[i].first << "\t" << graph2[i].second << endl;
-			file2 << graph3[i].first << "\t" << graph3[i].second << endl;
+		AsyncWriter writer1(file1);
+		AsyncWriter writer2(file2);
+		for (double x : selection) {
+			writer1.push(x, ed.density(x));
+			writer2.push(x, ed2.density(x));
 		}
+		writer1.close();
+		writer2.close();
 		///
 	}
 	catch (const int error) {
@@ -60,5 +64,9 @@ int main(int argc, char** argv) {
 	}
 	file1.close();
 	file2.close();
+#ifdef DISTRIBUTION_TRACING
+	ofstream trace("trace.json");
+	Tracing::write_chrome_trace(trace);
+#endif
 	run_unit_tests(argc, argv);
 }
\ No newline at end of file
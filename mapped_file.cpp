@@ -0,0 +1,77 @@
+#include "mapped_file.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path):
+	address(nullptr), length(0), file(nullptr), mapping(nullptr) {
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw 0;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		throw 0;
+	}
+	length = (size_t)file_size.QuadPart;
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		throw 0;
+	}
+	address = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (address == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw 0;
+	}
+}
+
+MappedFile::~MappedFile() {
+	UnmapViewOfFile(address);
+	CloseHandle(mapping);
+	CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::string& path):
+	address(nullptr), length(0), file(-1) {
+	file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw 0;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close(file);
+		throw 0;
+	}
+	length = (size_t)info.st_size;
+	void* result = mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+	if (result == MAP_FAILED) {
+		close(file);
+		throw 0;
+	}
+	address = (const char*)result;
+}
+
+MappedFile::~MappedFile() {
+	munmap((void*)address, length);
+	close(file);
+}
+#endif
+
+const char* MappedFile::data() const {
+	return address;
+}
+
+size_t MappedFile::size() const {
+	return length;
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "distributions.h"
+#include "binary_format.h"
+#include "text_format.h"
+#include "quantile_solver.h"
 
 template<class Distribution1, class Distribution2>
 class MixtureDistribution : public IDistribution, public IPresistend {
@@ -12,11 +15,16 @@ public:
 	double kurtosis() const override;
 	double asymmetry() const override;
 	double rand_var() const override;
+	double distribution_function(const double x) const override;
+	double quantile(const double p) const override;
 	std::vector<double> generate_selection(const int n) const override;
-	std::vector<std::pair<double, double>> generate_graph_selection(const std::vector<double>& selection) const override;
+	void batch_density(std::span<const double> x, std::span<double> result) const override;
+	GraphSelection generate_graph_selection(std::span<const double> selection) const override;
 
-	void load_from_file(std::ifstream& file) override;
-	void save_in_file(std::ofstream& file) override;
+	void load_from_file(std::istream& file) override;
+	void save_in_file(std::ostream& file) override;
+	void load_from_binary(std::istream& file) override;
+	void save_in_binary(std::ostream& file) override;
 
 	double get_p() const;
 	void set_p(const double p);
@@ -46,16 +54,19 @@ void MixtureDistribution<Dist1, Dist2>::set_p(const double p) {
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2>::density(const double x) const {
+	DISTRIBUTION_SCOPE("mixture", density);
 	return (1 - p) * d1.density(x) + p * d2.density(x);
 }
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2>::expected_value() const {
+	DISTRIBUTION_SCOPE("mixture", moments);
 	return (1 - p) * d1.expected_value() + p * d2.expected_value();
 }
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2>::dispersion() const {
+	DISTRIBUTION_SCOPE("mixture", moments);
 	return (1 - p) * (pow(d1.expected_value(), 2) + d1.dispersion()) +
 		p * (pow(d2.expected_value(), 2) + d2.dispersion()) -
 		pow(expected_value(), 2);
@@ -63,6 +74,7 @@ double MixtureDistribution<Dist1, Dist2>::dispersion() const {
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2>::asymmetry() const {
+	DISTRIBUTION_SCOPE("mixture", moments);
 	return ((1 - p) * (pow((d1.expected_value() - expected_value()), 3) + 3 * (d1.expected_value() - expected_value()) * d1.dispersion() + pow(d1.dispersion(), 3 / 2) * d1.asymmetry()) +
 		p * (pow((d2.expected_value() - expected_value()), 3) + 3 * (d2.expected_value() - expected_value()) * d2.dispersion() + pow(d2.dispersion(), 3 / 2) * d2.asymmetry())) /
 		pow(dispersion(), 3 / 2);
@@ -70,6 +82,7 @@ double MixtureDistribution<Dist1, Dist2>::asymmetry() const {
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2> ::kurtosis() const {
+	DISTRIBUTION_SCOPE("mixture", moments);
 	return ((1 - p) * (pow((d1.expected_value() - expected_value()), 4) + 6 * d1.dispersion() * pow((d1.expected_value() - expected_value()), 2) +
 		4 * (d1.expected_value() - expected_value()) * pow(d1.dispersion(), 3 / 2) * d1.asymmetry() + pow(d1.dispersion(), 2) * d1.kurtosis()) +
 		p * (pow((d2.expected_value() - expected_value()), 4) + 6 * d2.dispersion() * pow((d2.expected_value() - expected_value()), 2) +
@@ -79,6 +92,7 @@ double MixtureDistribution<Dist1, Dist2> ::kurtosis() const {
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2>::random_var() const {
+	DISTRIBUTION_COUNT("mixture", rng_draw);
 	double r;
 	do r = (double)rand() / RAND_MAX; while (r == 0 || r == 1);
 	return r;
@@ -86,6 +100,7 @@ double MixtureDistribution<Dist1, Dist2>::random_var() const {
 
 template<class Dist1, class Dist2>
 double MixtureDistribution<Dist1, Dist2>::rand_var() const {
+	DISTRIBUTION_SCOPE("mixture", rand_var);
 	double r = random_var();
 	if (r > p) {
 		return d1.rand_var();
@@ -95,36 +110,92 @@ double MixtureDistribution<Dist1, Dist2>::rand_var() const {
 	}
 }
 
+template<class Dist1, class Dist2>
+double MixtureDistribution<Dist1, Dist2>::distribution_function(const double x) const {
+	DISTRIBUTION_SCOPE("mixture", distribution_function);
+	return (1 - p) * d1.distribution_function(x) + p * d2.distribution_function(x);
+}
+
+// The mixture quantile lies between the quantiles of its components, which bracket the root.
+template<class Dist1, class Dist2>
+double MixtureDistribution<Dist1, Dist2>::quantile(const double u) const {
+	DISTRIBUTION_SCOPE("mixture", quantile);
+	if (u < 0 || u > 1) {
+		throw 1;
+	}
+	double q1 = d1.quantile(u), q2 = d2.quantile(u);
+	double lower = std::min(q1, q2), upper = std::max(q1, q2);
+	if (lower == upper || u == 0 || u == 1) {
+		return u == 1 ? upper : lower;
+	}
+	return QuantileSolver::solve(u, lower, upper,
+		[this](const double x) { return distribution_function(x); },
+		[this](const double x) { return density(x); });
+}
+
 template<class Dist1, class Dist2>
 std::vector<double> MixtureDistribution<Dist1, Dist2>::generate_selection(const int n) const {
+	DISTRIBUTION_SCOPE("mixture", generate_selection);
+	DISTRIBUTION_TRACE("sampling", "mixture::generate_selection");
 	std::vector<double> sample;
 	for (int i = 0; i < n; ++i) {
 		sample.push_back(rand_var());
 	}
-	sort(sample.begin(), sample.end());
+	{
+		DISTRIBUTION_TRACE("sorting", "mixture::sort_selection");
+		sort(sample.begin(), sample.end());
+	}
 	return sample;
 }
 
 template<class Dist1, class Dist2>
-std::vector<std::pair<double, double>> MixtureDistribution<Dist1, Dist2>::generate_graph_selection(const std::vector<double>& selection) const {
-	std::vector<std::pair<double, double>> result;
-	for (int i = 0; i < selection.size(); ++i) {
-		result.push_back(std::make_pair(selection[i], density(selection[i])));
+void MixtureDistribution<Dist1, Dist2>::batch_density(std::span<const double> x, std::span<double> result) const {
+	DISTRIBUTION_SCOPE("mixture", batch_density);
+	if (result.size() < x.size()) {
+		throw 1;
 	}
+	std::vector<double> second(x.size());
+	d1.batch_density(x, result);
+	d2.batch_density(x, second);
+	for (size_t i = 0; i < x.size(); ++i) {
+		result[i] = (1 - p) * result[i] + p * second[i];
+	}
+}
+
+template<class Dist1, class Dist2>
+GraphSelection MixtureDistribution<Dist1, Dist2>::generate_graph_selection(std::span<const double> selection) const {
+	GraphSelection result{ selection, std::vector<double>(selection.size()) };
+	batch_density(selection, result.density);
 	return result;
 }
 
 template<class Dist1, class Dist2>
-void MixtureDistribution<Dist1, Dist2>::save_in_file(std::ofstream& file){
-	file << p << std::endl;
+void MixtureDistribution<Dist1, Dist2>::save_in_file(std::ostream& file){
+	TextFormat::write_double(file, p);
 	component1().save_in_file(file);
 	component2().save_in_file(file);
 	
 }
 
 template<class Dist1, class Dist2>
-void MixtureDistribution<Dist1, Dist2>::load_from_file(std::ifstream& file) {
+void MixtureDistribution<Dist1, Dist2>::load_from_file(std::istream& file) {
 	file >> p;
 	component1().load_from_file(file);
 	component2().load_from_file(file);
+}
+
+template<class Dist1, class Dist2>
+void MixtureDistribution<Dist1, Dist2>::save_in_binary(std::ostream& file) {
+	BinaryFormat::write_header(file, DistributionTag::mixture);
+	BinaryFormat::write_double(file, p);
+	component1().save_in_binary(file);
+	component2().save_in_binary(file);
+}
+
+template<class Dist1, class Dist2>
+void MixtureDistribution<Dist1, Dist2>::load_from_binary(std::istream& file) {
+	BinaryFormat::expect_header(file, DistributionTag::mixture);
+	set_p(BinaryFormat::read_double(file));
+	component1().load_from_binary(file);
+	component2().load_from_binary(file);
 }
\ No newline at end of file
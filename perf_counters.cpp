@@ -0,0 +1,95 @@
+#include "perf_counters.h"
+#if defined(__linux__)
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const uint64_t configs[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+PerfCounters::PerfCounters() {
+	for (int i = 0; i < events_number; ++i) {
+		descriptors[i] = -1;
+	}
+	for (int i = 0; i < events_number; ++i) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = configs[i];
+		attr.disabled = i == 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		descriptors[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : descriptors[0], 0);
+		if (descriptors[i] < 0) {
+			for (int j = 0; j < i; ++j) {
+				close(descriptors[j]);
+				descriptors[j] = -1;
+			}
+			descriptors[i] = -1;
+			return;
+		}
+	}
+}
+
+PerfCounters::~PerfCounters() {
+	for (int i = 0; i < events_number; ++i) {
+		if (descriptors[i] >= 0) {
+			close(descriptors[i]);
+		}
+	}
+}
+
+bool PerfCounters::is_available() const {
+	return descriptors[0] >= 0;
+}
+
+void PerfCounters::start() {
+	if (!is_available()) {
+		return;
+	}
+	ioctl(descriptors[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(descriptors[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Values are scaled by enabled / running time in case the kernel multiplexed the group.
+PerfReading PerfCounters::stop() {
+	PerfReading reading{ false, 0, 0, 0, 0 };
+	if (!is_available()) {
+		return reading;
+	}
+	ioctl(descriptors[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	uint64_t values[3 + events_number];
+	if (read(descriptors[0], values, sizeof(values)) != sizeof(values) || values[0] != events_number || values[2] == 0) {
+		return reading;
+	}
+	double scale = (double)values[1] / values[2];
+	reading.valid = true;
+	reading.cycles = values[3] * scale;
+	reading.instructions = values[4] * scale;
+	reading.cache_misses = values[5] * scale;
+	reading.branch_misses = values[6] * scale;
+	return reading;
+}
+#else
+PerfCounters::PerfCounters() {
+	for (int i = 0; i < events_number; ++i) {
+		descriptors[i] = -1;
+	}
+}
+
+PerfCounters::~PerfCounters() {}
+
+bool PerfCounters::is_available() const {
+	return false;
+}
+
+void PerfCounters::start() {}
+
+PerfReading PerfCounters::stop() {
+	return PerfReading{ false, 0, 0, 0, 0 };
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+struct PerfReading {
+	bool valid;
+	double cycles;
+	double instructions;
+	double cache_misses;
+	double branch_misses;
+};
+
+// Optional hardware counter instrumentation over Linux perf_event_open. The
+// four counters run as one group around the measured region. When the kernel
+// refuses access (or on other platforms) is_available() is false and every
+// reading comes back invalid, so callers can wrap code unconditionally.
+class PerfCounters {
+public:
+	PerfCounters();
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+	~PerfCounters();
+
+	bool is_available() const;
+	void start();
+	PerfReading stop();
+
+	// Runs f once and reports the counters divided by `items`, e.g. per generated sample.
+	template<class F>
+	PerfReading measure(F&& f, const double items = 1) {
+		start();
+		f();
+		PerfReading reading = stop();
+		if (reading.valid && items > 0) {
+			reading.cycles /= items;
+			reading.instructions /= items;
+			reading.cache_misses /= items;
+			reading.branch_misses /= items;
+		}
+		return reading;
+	}
+private:
+	static const int events_number = 4;
+	int descriptors[events_number];
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+// Root of cdf(x) = p inside a bracket with cdf(lower) <= p <= cdf(upper).
+// Newton steps on the density are taken while they stay inside the shrinking
+// bracket and bisection otherwise, so the iteration also converges where the
+// density vanishes or the distribution function is only piecewise smooth.
+class QuantileSolver {
+public:
+	static constexpr double tolerance = 1e-14;
+	static const int max_iterations = 200;
+
+	template<class Cdf, class Density>
+	static double solve(const double p, double lower, double upper, Cdf cdf, Density density) {
+		double x = (lower + upper) / 2;
+		for (int i = 0; i < max_iterations; ++i) {
+			double f = cdf(x) - p;
+			if (f == 0) {
+				return x;
+			}
+			f < 0 ? lower = x : upper = x;
+			double d = density(x);
+			double next = d > 0 ? x - f / d : lower;
+			if (next <= lower || next >= upper) {
+				next = (lower + upper) / 2;
+			}
+			if (std::abs(next - x) <= tolerance * std::max(1.0, std::abs(x))) {
+				return next;
+			}
+			x = next;
+		}
+		return x;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "sample_store.h"
+#include "binary_format.h"
+#include "tracing.h"
+#include <bit>
+#include <cmath>
+#include <sstream>
+
+static uint64_t order_key(const double x) {
+	uint64_t bits = std::bit_cast<uint64_t>(x);
+	return bits >> 63 ? ~bits : bits | (1ull << 63);
+}
+
+static double from_order_key(const uint64_t key) {
+	return std::bit_cast<double>(key >> 63 ? key & ~(1ull << 63) : ~key);
+}
+
+ChunkSummary SampleStore::summarize(std::span<const double> values) {
+	ChunkSummary summary{};
+	summary.count = values.size();
+	if (values.empty()) {
+		return summary;
+	}
+	summary.min = values[0];
+	summary.max = values[0];
+	double sum = 0;
+	for (double x : values) {
+		summary.min = std::min(summary.min, x);
+		summary.max = std::max(summary.max, x);
+		sum += x;
+	}
+	summary.mean = sum / values.size();
+	for (double x : values) {
+		double d = x - summary.mean;
+		summary.m2 += d * d;
+		summary.m3 += d * d * d;
+		summary.m4 += d * d * d * d;
+	}
+	return summary;
+}
+
+// Pairwise update of the mean and central moment sums of two disjoint parts.
+ChunkSummary SampleStore::combine(const ChunkSummary& a, const ChunkSummary& b) {
+	if (a.count == 0) {
+		return b;
+	}
+	if (b.count == 0) {
+		return a;
+	}
+	ChunkSummary result{};
+	double na = a.count, nb = b.count, n = na + nb;
+	double delta = b.mean - a.mean;
+	result.count = a.count + b.count;
+	result.min = std::min(a.min, b.min);
+	result.max = std::max(a.max, b.max);
+	result.mean = a.mean + delta * nb / n;
+	result.m2 = a.m2 + b.m2 + delta * delta * na * nb / n;
+	result.m3 = a.m3 + b.m3 + pow(delta, 3) * na * nb * (na - nb) / (n * n) + 3 * delta * (na * b.m2 - nb * a.m2) / n;
+	result.m4 = a.m4 + b.m4 + pow(delta, 4) * na * nb * (na * na - na * nb + nb * nb) / (n * n * n) +
+		6 * delta * delta * (na * na * b.m2 + nb * nb * a.m2) / (n * n) + 4 * delta * (na * b.m3 - nb * a.m3) / n;
+	return result;
+}
+
+std::string SampleStore::encode(std::span<const double> values, SampleCodec codec) {
+	std::ostringstream stream;
+	if (codec == SampleCodec::raw) {
+		BinaryFormat::write_doubles(stream, values.data(), values.size());
+		return stream.str();
+	}
+	std::vector<uint64_t> deltas(values.size() > 0 ? values.size() - 1 : 0);
+	uint64_t widest = 0;
+	for (size_t i = 1; i < values.size(); ++i) {
+		int64_t delta = (int64_t)(order_key(values[i]) - order_key(values[i - 1]));
+		deltas[i - 1] = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+		widest |= deltas[i - 1];
+	}
+	int width = 64 - std::countl_zero(widest);
+	BinaryFormat::write_integer(stream, values.empty() ? 0 : order_key(values[0]), 8);
+	BinaryFormat::write_integer(stream, width, 1);
+	std::string packed((deltas.size() * width + 7) / 8, '\0');
+	size_t bit = 0;
+	for (uint64_t delta : deltas) {
+		for (int done = 0; done < width;) {
+			int shift = bit % 8;
+			int take = std::min(8 - shift, width - done);
+			packed[bit / 8] |= (char)(((delta >> done) & ((1u << take) - 1)) << shift);
+			done += take;
+			bit += take;
+		}
+	}
+	stream.write(packed.data(), packed.size());
+	return stream.str();
+}
+
+void SampleStore::decode(const std::string& bytes, SampleCodec codec, std::vector<double>& values) {
+	std::istringstream stream(bytes);
+	if (codec == SampleCodec::raw) {
+		BinaryFormat::read_doubles(stream, values.data(), values.size());
+		return;
+	}
+	if (values.empty()) {
+		return;
+	}
+	uint64_t key = BinaryFormat::read_integer(stream, 8);
+	int width = (int)BinaryFormat::read_integer(stream, 1);
+	if (width > 64 || bytes.size() < 9 + ((values.size() - 1) * width + 7) / 8) {
+		throw 0;
+	}
+	const unsigned char* packed = (const unsigned char*)bytes.data() + 9;
+	values[0] = from_order_key(key);
+	size_t bit = 0;
+	for (size_t i = 1; i < values.size(); ++i) {
+		uint64_t zigzag = 0;
+		for (int done = 0; done < width;) {
+			int shift = bit % 8;
+			int take = std::min(8 - shift, width - done);
+			zigzag |= (uint64_t)((packed[bit / 8] >> shift) & ((1u << take) - 1)) << done;
+			done += take;
+			bit += take;
+		}
+		int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+		key += (uint64_t)delta;
+		values[i] = from_order_key(key);
+	}
+}
+
+void SampleStore::write(const std::string& path, std::span<const double> sample, SampleCodec codec, const size_t chunk_size) {
+	DISTRIBUTION_TRACE("persistence", "sample_store::write");
+	if (chunk_size < 1) {
+		throw 1;
+	}
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file.is_open()) {
+		throw 0;
+	}
+	const size_t chunk_limit = std::min(chunk_size, std::max(sample.size(), (size_t)1));
+	if (chunk_limit > UINT32_MAX) {
+		throw 1;
+	}
+	BinaryFormat::write_header(file, DistributionTag::sample_store);
+	BinaryFormat::write_integer(file, (uint32_t)codec, 4);
+	BinaryFormat::write_integer(file, chunk_limit, 4);
+	uint64_t offset = BinaryFormat::header_size + 8;
+	std::vector<ChunkSummary> chunks;
+	for (size_t first = 0; first < sample.size(); first += chunk_size) {
+		auto values = sample.subspan(first, std::min(chunk_size, sample.size() - first));
+		ChunkSummary summary = summarize(values);
+		std::string bytes = encode(values, codec);
+		file.write(bytes.data(), bytes.size());
+		summary.offset = offset;
+		summary.bytes = bytes.size();
+		offset += bytes.size();
+		chunks.push_back(summary);
+	}
+	for (const auto& chunk : chunks) {
+		BinaryFormat::write_integer(file, chunk.offset, 8);
+		BinaryFormat::write_integer(file, chunk.bytes, 8);
+		BinaryFormat::write_integer(file, chunk.count, 8);
+		double stats[] = { chunk.min, chunk.max, chunk.mean, chunk.m2, chunk.m3, chunk.m4 };
+		BinaryFormat::write_doubles(file, stats, 6);
+	}
+	BinaryFormat::write_integer(file, chunks.size(), 8);
+	BinaryFormat::write_integer(file, offset, 8);
+	file.close();
+	if (!file) {
+		throw 0;
+	}
+}
+
+SampleStore::SampleStore(const std::string& path):
+	file(path, std::ios::in | std::ios::binary), total{} {
+	if (!file.is_open()) {
+		throw 0;
+	}
+	BinaryFormat::expect_header(file, DistributionTag::sample_store);
+	codec = (SampleCodec)BinaryFormat::read_integer(file, 4);
+	const uint64_t chunk_limit = BinaryFormat::read_integer(file, 4);
+	if ((codec != SampleCodec::raw && codec != SampleCodec::delta_bitpack) || chunk_limit < 1) {
+		throw 0;
+	}
+	file.seekg(-16, std::ios::end);
+	const std::streampos trailer = file.tellg();
+	uint64_t count = BinaryFormat::read_integer(file, 8);
+	uint64_t directory = BinaryFormat::read_integer(file, 8);
+	// The directory must fill the file exactly up to the trailer, which bounds the allocation below.
+	const uint64_t data_begin = BinaryFormat::header_size + 8;
+	if (trailer == std::streampos(-1) || directory < data_begin || directory > (uint64_t)trailer ||
+		count != ((uint64_t)trailer - directory) / directory_entry_size || directory + count * directory_entry_size != (uint64_t)trailer) {
+		throw 0;
+	}
+	file.seekg(directory);
+	chunks.resize(count);
+	uint64_t next_offset = data_begin;
+	for (auto& chunk : chunks) {
+		chunk.offset = BinaryFormat::read_integer(file, 8);
+		chunk.bytes = BinaryFormat::read_integer(file, 8);
+		chunk.count = BinaryFormat::read_integer(file, 8);
+		// Chunks are packed back to back between the header and the directory.
+		if (chunk.offset != next_offset || chunk.offset > directory || chunk.bytes > directory - chunk.offset) {
+			throw 0;
+		}
+		next_offset = chunk.offset + chunk.bytes;
+		if (!valid_count(chunk, codec, chunk_limit)) {
+			throw 0;
+		}
+		double stats[6];
+		BinaryFormat::read_doubles(file, stats, 6);
+		chunk.min = stats[0];
+		chunk.max = stats[1];
+		chunk.mean = stats[2];
+		chunk.m2 = stats[3];
+		chunk.m3 = stats[4];
+		chunk.m4 = stats[5];
+		total = combine(total, chunk);
+	}
+	if (next_offset != directory) {
+		throw 0;
+	}
+}
+
+// The count is checked against the encoded size before read_chunk allocates for it: a delta_bitpack chunk
+// packs count - 1 deltas of 1 to 64 bits each, except identical values, which pack zero-width deltas and
+// are bounded only by the chunk size recorded by write.
+bool SampleStore::valid_count(const ChunkSummary& chunk, SampleCodec codec, const uint64_t chunk_limit) {
+	if (chunk.count < 1 || chunk.count > chunk_limit) {
+		return false;
+	}
+	if (codec == SampleCodec::raw) {
+		return chunk.bytes % sizeof(double) == 0 && chunk.count == chunk.bytes / sizeof(double);
+	}
+	if (chunk.bytes < 9) {
+		return false;
+	}
+	const uint64_t packed = chunk.bytes - 9;
+	return packed == 0 || (chunk.count - 1 <= packed * 8 && packed <= (chunk.count - 1) * 8);
+}
+
+uint64_t SampleStore::get_size() const {
+	return total.count;
+}
+
+int SampleStore::get_chunks_number() const {
+	return chunks.size();
+}
+
+const ChunkSummary& SampleStore::get_chunk(const int i) const {
+	return chunks.at(i);
+}
+
+const ChunkSummary& SampleStore::get_summary() const {
+	return total;
+}
+
+SampleCodec SampleStore::get_codec() const {
+	return codec;
+}
+
+double SampleStore::expected_value() const {
+	return total.mean;
+}
+
+double SampleStore::dispersion() const {
+	return total.m2 / total.count;
+}
+
+double SampleStore::asymmetry() const {
+	return total.m3 / (total.count * pow(dispersion(), 1.5));
+}
+
+double SampleStore::kurtosis() const {
+	return total.m4 / (total.count * pow(dispersion(), 2)) - 3;
+}
+
+double SampleStore::get_min() const {
+	return total.min;
+}
+
+double SampleStore::get_max() const {
+	return total.max;
+}
+
+std::vector<double> SampleStore::read_chunk(const int i) {
+	DISTRIBUTION_TRACE("persistence", "sample_store::read_chunk");
+	const ChunkSummary& chunk = chunks.at(i);
+	std::string bytes(chunk.bytes, '\0');
+	file.clear();
+	file.seekg(chunk.offset);
+	file.read(bytes.data(), bytes.size());
+	if (!file) {
+		throw 0;
+	}
+	std::vector<double> values(chunk.count);
+	decode(bytes, codec, values);
+	return values;
+}
+
+std::vector<double> SampleStore::read(const uint64_t first, const uint64_t count) {
+	std::vector<double> result;
+	uint64_t position = 0;
+	for (size_t i = 0; i < chunks.size() && position < first + count; ++i) {
+		uint64_t next = position + chunks[i].count;
+		if (next > first) {
+			auto values = read_chunk(i);
+			uint64_t from = first > position ? first - position : 0;
+			uint64_t to = std::min(chunks[i].count, first + count - position);
+			result.insert(result.end(), values.begin() + from, values.begin() + to);
+		}
+		position = next;
+	}
+	return result;
+}
+
+// Chunks whose bounds miss [lower, upper] are skipped without being read.
+std::vector<double> SampleStore::read_values(const double lower, const double upper) {
+	std::vector<double> result;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		if (chunks[i].max < lower || chunks[i].min > upper) {
+			continue;
+		}
+		for (double x : read_chunk(i)) {
+			if (x >= lower && x <= upper) {
+				result.push_back(x);
+			}
+		}
+	}
+	return result;
+}
+
+std::vector<double> SampleStore::read_all() {
+	return read(0, total.count);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class SampleCodec : uint32_t { raw = 0, delta_bitpack = 1 };
+
+struct ChunkSummary {
+	uint64_t offset;
+	uint64_t bytes;
+	uint64_t count;
+	double min;
+	double max;
+	double mean;
+	double m2;
+	double m3;
+	double m4;
+};
+
+// Chunked columnar archive of a sample. Every chunk is summarised in a directory
+// at the end of the file (bounds, count, mean and central moment sums), so the
+// moments of the whole sample come from the directory alone and reads only
+// decompress the chunks they touch.
+//
+// delta_bitpack maps every double onto an order-preserving integer key and
+// stores the zigzag deltas between neighbours with the smallest common bit
+// width of the chunk. It is lossless and pays off most on sorted samples.
+class SampleStore {
+public:
+	SampleStore(const std::string& path);
+
+	static void write(const std::string& path, std::span<const double> sample, SampleCodec codec = SampleCodec::delta_bitpack, const size_t chunk_size = 1 << 16);
+
+	uint64_t get_size() const;
+	int get_chunks_number() const;
+	const ChunkSummary& get_chunk(const int i) const;
+	SampleCodec get_codec() const;
+	// Directory summary of the whole sample.
+	const ChunkSummary& get_summary() const;
+
+	double expected_value() const;
+	double dispersion() const;
+	double asymmetry() const;
+	double kurtosis() const;
+	double get_min() const;
+	double get_max() const;
+
+	std::vector<double> read_chunk(const int i);
+	std::vector<double> read(const uint64_t first, const uint64_t count);
+	std::vector<double> read_values(const double lower, const double upper);
+	std::vector<double> read_all();
+private:
+	std::ifstream file;
+	SampleCodec codec;
+	std::vector<ChunkSummary> chunks;
+	ChunkSummary total;
+
+	static const size_t directory_entry_size = 72;
+
+	static ChunkSummary summarize(std::span<const double> values);
+	static ChunkSummary combine(const ChunkSummary& a, const ChunkSummary& b);
+	static bool valid_count(const ChunkSummary& chunk, SampleCodec codec, const uint64_t chunk_limit);
+	static std::string encode(std::span<const double> values, SampleCodec codec);
+	static void decode(const std::string& bytes, SampleCodec codec, std::vector<double>& values);
+};
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "sobol_sequence.h"
+#include <cstdlib>
+
+namespace {
+	// Degree s, coefficients a and initial numbers m of the primitive polynomials
+	// for dimensions 2 and up (new-joe-kuo-6.21201); dimension 1 is van der Corput.
+	struct Polynomial {
+		int s;
+		uint32_t a;
+		uint32_t m[5];
+	};
+
+	const Polynomial polynomials[SobolSequence::max_dimensions - 1] = {
+		{ 1, 0, { 1 } },
+		{ 2, 1, { 1, 3 } },
+		{ 3, 1, { 1, 3, 1 } },
+		{ 3, 2, { 1, 1, 1 } },
+		{ 4, 1, { 1, 1, 3, 3 } },
+		{ 4, 4, { 1, 3, 5, 13 } },
+		{ 5, 2, { 1, 1, 5, 5, 17 } },
+	};
+
+	// Direction numbers v[d][k], already shifted to the top of a 32-bit word.
+	struct Directions {
+		uint32_t v[SobolSequence::max_dimensions][SobolSequence::bits];
+
+		Directions() {
+			const int bits = SobolSequence::bits;
+			for (int k = 0; k < bits; ++k) {
+				v[0][k] = 1u << (bits - 1 - k);
+			}
+			for (int d = 1; d < SobolSequence::max_dimensions; ++d) {
+				const Polynomial& p = polynomials[d - 1];
+				for (int k = 0; k < bits; ++k) {
+					if (k < p.s) {
+						v[d][k] = p.m[k] << (bits - 1 - k);
+						continue;
+					}
+					v[d][k] = v[d][k - p.s] ^ (v[d][k - p.s] >> p.s);
+					for (int j = 1; j < p.s; ++j) {
+						if ((p.a >> (p.s - 1 - j)) & 1) {
+							v[d][k] ^= v[d][k - j];
+						}
+					}
+				}
+			}
+		}
+	};
+
+	const Directions directions;
+
+	int trailing_zeros(uint32_t x) {
+		int count = 0;
+		while ((x & 1) == 0) {
+			x >>= 1;
+			++count;
+		}
+		return count;
+	}
+}
+
+SobolSequence::SobolSequence(const int dimensions, const bool scrambled):
+	dimensions(dimensions > 0 && dimensions <= max_dimensions ? dimensions : throw 1), scrambled(scrambled), index(0), state{}, seeds{} {
+	if (scrambled) {
+		for (int d = 0; d < dimensions; ++d) {
+			for (int i = 0; i < 4; ++i) {
+				seeds[d] = seeds[d] << 8 ^ (uint32_t)rand();
+			}
+		}
+	}
+}
+
+uint32_t SobolSequence::reverse_bits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	return ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+}
+
+// Laine-Karras permutation of the reversed bits: every output bit depends only on
+// the input bits above it, which is exactly a nested uniform (Owen) scramble.
+uint32_t SobolSequence::scramble(uint32_t x, const uint32_t seed) {
+	x = reverse_bits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverse_bits(x);
+}
+
+double SobolSequence::coordinate(const int d) const {
+	uint32_t x = scrambled ? scramble(state[d], seeds[d]) : state[d];
+	return (x + 0.5) / 4294967296.0;
+}
+
+// Gray code step: point i + 1 differs from point i by the direction number of the lowest zero bit of i.
+void SobolSequence::advance() {
+	if (index == UINT32_MAX) {
+		throw 1;
+	}
+	const int c = trailing_zeros(~index);
+	for (int d = 0; d < dimensions; ++d) {
+		state[d] ^= directions.v[d][c];
+	}
+	++index;
+}
+
+double SobolSequence::next() {
+	double x = coordinate(0);
+	advance();
+	return x;
+}
+
+void SobolSequence::next(std::span<double> point) {
+	if (point.size() != (size_t)dimensions) {
+		throw 1;
+	}
+	for (int d = 0; d < dimensions; ++d) {
+		point[d] = coordinate(d);
+	}
+	advance();
+}
+
+void SobolSequence::reset() {
+	index = 0;
+	state.fill(0);
+}
+
+int SobolSequence::get_dimensions() const {
+	return dimensions;
+}
+
+uint32_t SobolSequence::get_index() const {
+	return index;
+}
+
+bool SobolSequence::is_scrambled() const {
+	return scrambled;
+}
\ No newline at end of file
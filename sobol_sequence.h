@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+
+// Low-discrepancy points of the Sobol sequence in up to max_dimensions
+// dimensions with the Joe-Kuo direction numbers. Points are produced in Gray
+// code order, one XOR per coordinate, so every prefix of 2^m points is the
+// same set as in the natural order. A scrambled sequence passes each
+// coordinate through a hash-based Owen scramble: the stratification of every
+// dyadic interval is kept, while averages over the points become unbiased
+// randomized quasi-Monte Carlo estimates. The scrambling seeds are drawn from
+// rand(), so srand() still makes a run reproducible. Coordinates carry 32 bits
+// and are placed at the centre of their cell, never at 0 or 1, so they can be
+// passed to a quantile function as they are.
+class SobolSequence {
+public:
+	static const int max_dimensions = 8;
+	static const int bits = 32;
+
+	SobolSequence(const int dimensions = 1, const bool scrambled = true);
+
+	// First coordinate of the next point, the whole sequence of a one-dimensional generator.
+	double next();
+	void next(std::span<double> point);
+	void reset();
+
+	int get_dimensions() const;
+	uint32_t get_index() const;
+	bool is_scrambled() const;
+private:
+	int dimensions;
+	bool scrambled;
+	uint32_t index;
+	std::array<uint32_t, max_dimensions> state;
+	std::array<uint32_t, max_dimensions> seeds;
+
+	void advance();
+	double coordinate(const int d) const;
+	static uint32_t scramble(uint32_t x, const uint32_t seed);
+	static uint32_t reverse_bits(uint32_t x);
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "text_format.h"
+#include <charconv>
+
+static bool is_space(const char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+std::vector<double> TextFormat::read_doubles(std::istream& file) {
+	std::vector<double> result;
+	std::string buffer(buffer_size, '\0');
+	size_t carried = 0;
+	while (true) {
+		file.read(buffer.data() + carried, buffer.size() - carried);
+		size_t length = carried + (size_t)file.gcount();
+		bool last = length < buffer.size();
+		size_t end = length;
+		if (!last) {
+			while (end > 0 && !is_space(buffer[end - 1])) {
+				--end;
+			}
+			if (end == 0) {
+				buffer.resize(buffer.size() * 2);
+				carried = length;
+				continue;
+			}
+		}
+		const char* position = buffer.data();
+		const char* limit = buffer.data() + end;
+		while (true) {
+			while (position < limit && is_space(*position)) {
+				++position;
+			}
+			if (position == limit) {
+				break;
+			}
+			double x;
+			auto parsed = std::from_chars(position, limit, x);
+			if (parsed.ec != std::errc() || (parsed.ptr < limit && !is_space(*parsed.ptr))) {
+				throw 0;
+			}
+			result.push_back(x);
+			position = parsed.ptr;
+		}
+		if (last) {
+			return result;
+		}
+		carried = length - end;
+		std::copy(buffer.begin() + end, buffer.begin() + length, buffer.begin());
+	}
+}
+
+void TextFormat::append(std::string& buffer, const double x) {
+	char digits[32];
+	auto result = std::to_chars(digits, digits + sizeof(digits), x);
+	buffer.append(digits, result.ptr);
+}
+
+void TextFormat::write_double(std::ostream& file, const double x) {
+	std::string buffer;
+	append(buffer, x);
+	buffer.push_back('\n');
+	file.write(buffer.data(), buffer.size());
+}
+
+void TextFormat::write_doubles(std::ostream& file, std::span<const double> values) {
+	write_rows(file, values, 1);
+}
+
+// Values are laid out row by row, tab separated, a newline after every `columns` values.
+void TextFormat::write_rows(std::ostream& file, std::span<const double> values, const int columns) {
+	std::string buffer;
+	buffer.reserve(buffer_size + 64);
+	for (size_t i = 0; i < values.size(); ++i) {
+		append(buffer, values[i]);
+		buffer.push_back((i + 1) % columns == 0 ? '\n' : '\t');
+		if (buffer.size() >= buffer_size) {
+			file.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+	}
+	file.write(buffer.data(), buffer.size());
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+// Locale-independent text interchange built on std::from_chars / std::to_chars.
+// Reading and writing go through large buffers, and doubles are written in the
+// shortest form that parses back to the same value.
+class TextFormat {
+public:
+	static std::vector<double> read_doubles(std::istream& file);
+	static void write_double(std::ostream& file, const double x);
+	static void write_doubles(std::ostream& file, std::span<const double> values);
+	static void write_rows(std::ostream& file, std::span<const double> values, const int columns);
+private:
+	static const size_t buffer_size = 1 << 16;
+
+	static void append(std::string& buffer, const double x);
+};
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "tracing.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+	// Single producer ring: only the owning thread writes events and advances head.
+	struct Buffer {
+		Tracing::Event events[Tracing::buffer_capacity];
+		std::atomic<uint64_t> head{0};
+		std::atomic<uint64_t> tail{0};
+		int thread;
+	};
+
+	// Buffers are registered once per thread and kept after the thread exits,
+	// so the spans of finished worker threads still reach the export.
+	struct Registry {
+		std::mutex mutex;
+		std::vector<std::shared_ptr<Buffer>> buffers;
+	};
+
+	Registry& registry() {
+		static Registry instance;
+		return instance;
+	}
+
+	Buffer& thread_buffer() {
+		thread_local std::shared_ptr<Buffer> buffer = [] {
+			auto created = std::make_shared<Buffer>();
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			created->thread = (int)registry().buffers.size() + 1;
+			registry().buffers.push_back(created);
+			return created;
+		}();
+		return *buffer;
+	}
+
+	// Chrome trace timestamps are microseconds; the nanosecond part is kept as three decimals.
+	void write_microseconds(std::ostream& out, const int64_t nanoseconds) {
+		const char fraction[] = { char('0' + nanoseconds / 100 % 10), char('0' + nanoseconds / 10 % 10), char('0' + nanoseconds % 10), '\0' };
+		out << nanoseconds / 1000 << '.' << fraction;
+	}
+
+	void write_string(std::ostream& out, const char* text) {
+		out << '"';
+		for (; *text; ++text) {
+			if (*text == '"' || *text == '\\') {
+				out << '\\';
+			}
+			out << *text;
+		}
+		out << '"';
+	}
+}
+
+Tracing::Span::Span(const char* category, const char* name): category(category), name(name), start(std::chrono::steady_clock::now()) {
+}
+
+Tracing::Span::~Span() {
+	record(category, name, start, std::chrono::steady_clock::now());
+}
+
+void Tracing::record(const char* category, const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	Buffer& buffer = thread_buffer();
+	const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	Event& event = buffer.events[head % buffer_capacity];
+	event.category = category;
+	event.name = name;
+	event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+	event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Tracing::write_chrome_trace(std::ostream& out) {
+	std::vector<std::shared_ptr<Buffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		buffers = registry().buffers;
+	}
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto& buffer : buffers) {
+		const uint64_t head = buffer->head.load(std::memory_order_acquire);
+		const uint64_t tail = std::max(buffer->tail.load(std::memory_order_relaxed), head > buffer_capacity ? head - buffer_capacity : 0);
+		for (uint64_t i = tail; i < head; ++i) {
+			const Event& event = buffer->events[i % buffer_capacity];
+			out << (first ? "\n" : ",\n") << "{\"name\":";
+			write_string(out, event.name);
+			out << ",\"cat\":";
+			write_string(out, event.category);
+			out << ",\"ph\":\"X\",\"ts\":";
+			write_microseconds(out, event.start);
+			out << ",\"dur\":";
+			write_microseconds(out, event.duration);
+			out << ",\"pid\":1,\"tid\":" << buffer->thread << "}";
+			first = false;
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+// Drops the recorded spans by moving every tail up to its head; the buffers stay registered.
+void Tracing::clear() {
+	std::lock_guard<std::mutex> lock(registry().mutex);
+	for (const auto& buffer : registry().buffers) {
+		buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+size_t Tracing::events_number() {
+	std::lock_guard<std::mutex> lock(registry().mutex);
+	size_t result = 0;
+	for (const auto& buffer : registry().buffers) {
+		const uint64_t head = buffer->head.load(std::memory_order_acquire);
+		const uint64_t tail = std::max(buffer->tail.load(std::memory_order_relaxed), head > buffer_capacity ? head - buffer_capacity : 0);
+		result += head - tail;
+	}
+	return result;
+}
\ No newline at end of file
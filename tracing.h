@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Scoped tracing spans, compiled in only with DISTRIBUTION_TRACING defined.
+// Every thread appends finished spans to its own fixed-size ring buffer with
+// no locks on the recording path; when a buffer wraps, the oldest spans are
+// overwritten. write_chrome_trace() exports every buffer as Chrome trace JSON
+// (chrome://tracing, Perfetto) and should be called while no spans are being
+// recorded. Span names and categories must be string literals.
+class Tracing {
+public:
+	static const size_t buffer_capacity = 1 << 16;
+
+	struct Event {
+		const char* category;
+		const char* name;
+		int64_t start;
+		int64_t duration;
+	};
+
+	class Span {
+	public:
+		Span(const char* category, const char* name);
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+		~Span();
+	private:
+		const char* category;
+		const char* name;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	static void record(const char* category, const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	static void write_chrome_trace(std::ostream& out);
+	static void clear();
+	static size_t events_number();
+};
+
+#define DISTRIBUTION_TRACE_JOIN(a, b) a##b
+#define DISTRIBUTION_TRACE_NAME(line) DISTRIBUTION_TRACE_JOIN(tracing_span, line)
+
+#ifdef DISTRIBUTION_TRACING
+#define DISTRIBUTION_TRACE(category, name) Tracing::Span DISTRIBUTION_TRACE_NAME(__LINE__)(category, name)
+#else
+#define DISTRIBUTION_TRACE(category, name)
+#endif
\ No newline at end of file
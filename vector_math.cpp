@@ -0,0 +1,156 @@
+#include "vector_math.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+	uint64_t bits_of(const double x) {
+		uint64_t bits;
+		memcpy(&bits, &x, sizeof(bits));
+		return bits;
+	}
+
+	double from_bits(const uint64_t bits) {
+		double x;
+		memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+
+	// 2^k for -1022 <= k <= 1023.
+	double power2(const int k) {
+		return from_bits((uint64_t)(k + 1023) << 52);
+	}
+
+	// Without vector units the C library is faster than the lane-by-lane reference.
+	void scalar_exp(const double* x, double* result, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			result[i] = std::exp(x[i]);
+		}
+	}
+
+	void scalar_log(const double* x, double* result, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			result[i] = std::log(x[i]);
+		}
+	}
+
+	void scalar_abs(const double* x, double* result, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			result[i] = from_bits(bits_of(x[i]) & ~(1ull << 63));
+		}
+	}
+
+	void scalar_polynomial(const double* x, const double* coefficients, size_t degree, double* result, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			double p = coefficients[0];
+			for (size_t j = 1; j <= degree; ++j) {
+				p = p * x[i] + coefficients[j];
+			}
+			result[i] = p;
+		}
+	}
+
+	const VectorMath::Kernels scalar_kernels = { "scalar", scalar_exp, scalar_log, scalar_abs, scalar_polynomial };
+}
+
+double VectorMath::exp(const double x) {
+	if (x != x) {
+		return x;
+	}
+	const double clamped = std::fmin(std::fmax(x, exp_min), exp_max);
+	const double n = std::nearbyint(clamped * log2e);
+	const double r = (clamped - n * ln2_hi) - n * ln2_lo;
+	double p = exp_coefficients[0];
+	for (int j = 1; j < 14; ++j) {
+		p = p * r + exp_coefficients[j];
+	}
+	// Two factors keep both exponents in the normal range down to the smallest subnormal result.
+	const double half = std::floor(n * 0.5);
+	return p * power2((int)half) * power2((int)(n - half));
+}
+
+double VectorMath::log(const double x) {
+	if (!(x >= 0)) {
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	if (x == 0) {
+		return -std::numeric_limits<double>::infinity();
+	}
+	if (x == std::numeric_limits<double>::infinity()) {
+		return x;
+	}
+	double scaled = x;
+	double e = -1023;
+	if (x < DBL_MIN) {
+		scaled = x * 4503599627370496.0;
+		e -= 52;
+	}
+	const uint64_t bits = bits_of(scaled);
+	e += (double)(bits >> 52);
+	double m = from_bits((bits & ((1ull << 52) - 1)) | (1023ull << 52));
+	if (m > sqrt2) {
+		m *= 0.5;
+		e += 1;
+	}
+	const double f = m - 1;
+	const double s = f / (2 + f);
+	const double z = s * s;
+	double p = log_coefficients[0];
+	for (int j = 1; j < 11; ++j) {
+		p = p * z + log_coefficients[j];
+	}
+	const double r = z * p;
+	const double hfsq = 0.5 * f * f;
+	return e * ln2_hi + (f - (hfsq - (s * (hfsq + r) + e * ln2_lo)));
+}
+
+const VectorMath::Kernels& VectorMath::scalar() {
+	return scalar_kernels;
+}
+
+std::atomic<const VectorMath::Kernels*> VectorMath::selected{ nullptr };
+
+// The widest kernels this CPU runs, chosen on the first call.
+const VectorMath::Kernels& VectorMath::active() {
+	const Kernels* kernels = selected.load(std::memory_order_acquire);
+	if (!kernels) {
+		kernels = avx512() ? avx512() : avx2() ? avx2() : &scalar();
+		selected.store(kernels, std::memory_order_release);
+	}
+	return *kernels;
+}
+
+const char* VectorMath::instruction_set() {
+	return active().name;
+}
+
+bool VectorMath::set_instruction_set(const std::string& name) {
+	for (const Kernels* kernels : { avx512(), avx2(), &scalar() }) {
+		if (kernels && name == kernels->name) {
+			selected.store(kernels, std::memory_order_release);
+			return true;
+		}
+	}
+	return false;
+}
+
+void VectorMath::exp(std::span<const double> x, std::span<double> result) {
+	active().exp(x.data(), result.data(), x.size());
+}
+
+void VectorMath::log(std::span<const double> x, std::span<double> result) {
+	active().log(x.data(), result.data(), x.size());
+}
+
+void VectorMath::abs(std::span<const double> x, std::span<double> result) {
+	active().abs(x.data(), result.data(), x.size());
+}
+
+void VectorMath::polynomial(std::span<const double> x, std::span<const double> coefficients, std::span<double> result) {
+	if (coefficients.empty()) {
+		throw 1;
+	}
+	active().polynomial(x.data(), coefficients.data(), coefficients.size() - 1, result.data(), x.size());
+}
\ No newline at end of file
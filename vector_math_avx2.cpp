@@ -0,0 +1,132 @@
+#include "vector_math.h"
+#include "cpu_features.h"
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+
+// Compiled for AVX2 and FMA whatever the flags of the rest of the build;
+// VectorMath selects these kernels only when CPUID reports the extension.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+namespace {
+	const double magic = 6755399441055744.0;
+
+	// Integral doubles in [-2^51, 2^51] to int64 and back through the 1.5 * 2^52 bias.
+	__m256i to_integer(const __m256d n) {
+		return _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(magic))), _mm256_castpd_si256(_mm256_set1_pd(magic)));
+	}
+
+	__m256d to_double(const __m256i k) {
+		return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(k, _mm256_castpd_si256(_mm256_set1_pd(magic)))), _mm256_set1_pd(magic));
+	}
+
+	__m256d power2(const __m256d n) {
+		return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(to_integer(n), _mm256_set1_epi64x(1023)), 52));
+	}
+
+	__m256d exp4(const __m256d x) {
+		const __m256d clamped = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(VectorMath::exp_min)), _mm256_set1_pd(VectorMath::exp_max));
+		const __m256d n = _mm256_round_pd(_mm256_mul_pd(clamped, _mm256_set1_pd(VectorMath::log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(VectorMath::ln2_hi), clamped);
+		r = _mm256_fnmadd_pd(n, _mm256_set1_pd(VectorMath::ln2_lo), r);
+		__m256d p = _mm256_set1_pd(VectorMath::exp_coefficients[0]);
+		for (int j = 1; j < 14; ++j) {
+			p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(VectorMath::exp_coefficients[j]));
+		}
+		const __m256d half = _mm256_floor_pd(_mm256_mul_pd(n, _mm256_set1_pd(0.5)));
+		const __m256d result = _mm256_mul_pd(_mm256_mul_pd(p, power2(half)), power2(_mm256_sub_pd(n, half)));
+		return _mm256_blendv_pd(result, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+	}
+
+	__m256d log4(const __m256d x) {
+		const __m256d subnormal = _mm256_cmp_pd(x, _mm256_set1_pd(2.2250738585072014e-308), _CMP_LT_OQ);
+		const __m256d scaled = _mm256_blendv_pd(x, _mm256_mul_pd(x, _mm256_set1_pd(4503599627370496.0)), subnormal);
+		__m256d e = _mm256_blendv_pd(_mm256_set1_pd(-1023), _mm256_set1_pd(-1075), subnormal);
+		const __m256i bits = _mm256_castpd_si256(scaled);
+		e = _mm256_add_pd(e, to_double(_mm256_srli_epi64(bits, 52)));
+		__m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x((1ll << 52) - 1)), _mm256_set1_epi64x(1023ll << 52)));
+		const __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(VectorMath::sqrt2), _CMP_GT_OQ);
+		m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+		e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1)));
+		const __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1));
+		const __m256d s = _mm256_div_pd(f, _mm256_add_pd(f, _mm256_set1_pd(2)));
+		const __m256d z = _mm256_mul_pd(s, s);
+		__m256d p = _mm256_set1_pd(VectorMath::log_coefficients[0]);
+		for (int j = 1; j < 11; ++j) {
+			p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(VectorMath::log_coefficients[j]));
+		}
+		const __m256d r = _mm256_mul_pd(z, p);
+		const __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+		const __m256d inner = _mm256_fmadd_pd(s, _mm256_add_pd(hfsq, r), _mm256_mul_pd(e, _mm256_set1_pd(VectorMath::ln2_lo)));
+		__m256d result = _mm256_fmadd_pd(e, _mm256_set1_pd(VectorMath::ln2_hi), _mm256_sub_pd(f, _mm256_sub_pd(hfsq, inner)));
+		const __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+		result = _mm256_blendv_pd(result, infinity, _mm256_cmp_pd(x, infinity, _CMP_EQ_OQ));
+		result = _mm256_blendv_pd(result, _mm256_sub_pd(_mm256_setzero_pd(), infinity), _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_EQ_OQ));
+		return _mm256_blendv_pd(result, _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN()), _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_NGE_UQ));
+	}
+
+	void exp(const double* x, double* result, size_t size) {
+		size_t i = 0;
+		for (; i + 4 <= size; i += 4) {
+			_mm256_storeu_pd(result + i, exp4(_mm256_loadu_pd(x + i)));
+		}
+		for (; i < size; ++i) {
+			result[i] = VectorMath::exp(x[i]);
+		}
+	}
+
+	void log(const double* x, double* result, size_t size) {
+		size_t i = 0;
+		for (; i + 4 <= size; i += 4) {
+			_mm256_storeu_pd(result + i, log4(_mm256_loadu_pd(x + i)));
+		}
+		for (; i < size; ++i) {
+			result[i] = VectorMath::log(x[i]);
+		}
+	}
+
+	void abs(const double* x, double* result, size_t size) {
+		const __m256d sign = _mm256_set1_pd(-0.0);
+		size_t i = 0;
+		for (; i + 4 <= size; i += 4) {
+			_mm256_storeu_pd(result + i, _mm256_andnot_pd(sign, _mm256_loadu_pd(x + i)));
+		}
+		VectorMath::scalar().abs(x + i, result + i, size - i);
+	}
+
+	void polynomial(const double* x, const double* coefficients, size_t degree, double* result, size_t size) {
+		size_t i = 0;
+		for (; i + 4 <= size; i += 4) {
+			const __m256d v = _mm256_loadu_pd(x + i);
+			__m256d p = _mm256_set1_pd(coefficients[0]);
+			for (size_t j = 1; j <= degree; ++j) {
+				p = _mm256_fmadd_pd(p, v, _mm256_set1_pd(coefficients[j]));
+			}
+			_mm256_storeu_pd(result + i, p);
+		}
+		VectorMath::scalar().polynomial(x + i, coefficients, degree, result + i, size - i);
+	}
+
+	const VectorMath::Kernels kernels = { "avx2", exp, log, abs, polynomial };
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const VectorMath::Kernels* VectorMath::avx2() {
+	return CpuFeatures::avx2() && CpuFeatures::fma() ? &kernels : nullptr;
+}
+#else
+const VectorMath::Kernels* VectorMath::avx2() {
+	return nullptr;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "vector_math.h"
+#include "cpu_features.h"
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+
+// Compiled for AVX-512F whatever the flags of the rest of the build;
+// VectorMath selects these kernels only when CPUID reports the extension.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+// The helpers below are internal, so the __m512d calling convention never crosses
+// the TU; gcc 12 also flags the deliberately undefined registers of its own headers.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+namespace {
+	const double magic = 6755399441055744.0;
+
+	// Integral doubles in [-2^51, 2^51] to int64 and back through the 1.5 * 2^52 bias.
+	__m512i to_integer(const __m512d n) {
+		return _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(n, _mm512_set1_pd(magic))), _mm512_castpd_si512(_mm512_set1_pd(magic)));
+	}
+
+	__m512d to_double(const __m512i k) {
+		return _mm512_sub_pd(_mm512_castsi512_pd(_mm512_add_epi64(k, _mm512_castpd_si512(_mm512_set1_pd(magic)))), _mm512_set1_pd(magic));
+	}
+
+	__m512d power2(const __m512d n) {
+		return _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(to_integer(n), _mm512_set1_epi64(1023)), 52));
+	}
+
+	__m512d exp8(const __m512d x) {
+		const __m512d clamped = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(VectorMath::exp_min)), _mm512_set1_pd(VectorMath::exp_max));
+		const __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(clamped, _mm512_set1_pd(VectorMath::log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(VectorMath::ln2_hi), clamped);
+		r = _mm512_fnmadd_pd(n, _mm512_set1_pd(VectorMath::ln2_lo), r);
+		__m512d p = _mm512_set1_pd(VectorMath::exp_coefficients[0]);
+		for (int j = 1; j < 14; ++j) {
+			p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(VectorMath::exp_coefficients[j]));
+		}
+		const __m512d half = _mm512_roundscale_pd(_mm512_mul_pd(n, _mm512_set1_pd(0.5)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		const __m512d result = _mm512_mul_pd(_mm512_mul_pd(p, power2(half)), power2(_mm512_sub_pd(n, half)));
+		return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, x, _CMP_UNORD_Q), result, x);
+	}
+
+	__m512d log8(const __m512d x) {
+		const __mmask8 subnormal = _mm512_cmp_pd_mask(x, _mm512_set1_pd(2.2250738585072014e-308), _CMP_LT_OQ);
+		const __m512d scaled = _mm512_mask_mul_pd(x, subnormal, x, _mm512_set1_pd(4503599627370496.0));
+		__m512d e = _mm512_mask_blend_pd(subnormal, _mm512_set1_pd(-1023), _mm512_set1_pd(-1075));
+		const __m512i bits = _mm512_castpd_si512(scaled);
+		e = _mm512_add_pd(e, to_double(_mm512_srli_epi64(bits, 52)));
+		__m512d m = _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64((1ll << 52) - 1)), _mm512_set1_epi64(1023ll << 52)));
+		const __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(VectorMath::sqrt2), _CMP_GT_OQ);
+		m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+		e = _mm512_mask_add_pd(e, big, e, _mm512_set1_pd(1));
+		const __m512d f = _mm512_sub_pd(m, _mm512_set1_pd(1));
+		const __m512d s = _mm512_div_pd(f, _mm512_add_pd(f, _mm512_set1_pd(2)));
+		const __m512d z = _mm512_mul_pd(s, s);
+		__m512d p = _mm512_set1_pd(VectorMath::log_coefficients[0]);
+		for (int j = 1; j < 11; ++j) {
+			p = _mm512_fmadd_pd(p, z, _mm512_set1_pd(VectorMath::log_coefficients[j]));
+		}
+		const __m512d r = _mm512_mul_pd(z, p);
+		const __m512d hfsq = _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), f), f);
+		const __m512d inner = _mm512_fmadd_pd(s, _mm512_add_pd(hfsq, r), _mm512_mul_pd(e, _mm512_set1_pd(VectorMath::ln2_lo)));
+		__m512d result = _mm512_fmadd_pd(e, _mm512_set1_pd(VectorMath::ln2_hi), _mm512_sub_pd(f, _mm512_sub_pd(hfsq, inner)));
+		const __m512d infinity = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+		result = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, infinity, _CMP_EQ_OQ), result, infinity);
+		result = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_EQ_OQ), result, _mm512_sub_pd(_mm512_setzero_pd(), infinity));
+		return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_NGE_UQ), result, _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN()));
+	}
+
+	// The tail is handled with masked loads and stores instead of a scalar loop.
+	template<class F>
+	void apply(const double* x, double* result, size_t size, F f) {
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			_mm512_storeu_pd(result + i, f(_mm512_loadu_pd(x + i)));
+		}
+		if (i < size) {
+			const __mmask8 tail = (__mmask8)((1u << (size - i)) - 1);
+			_mm512_mask_storeu_pd(result + i, tail, f(_mm512_maskz_loadu_pd(tail, x + i)));
+		}
+	}
+
+	void exp(const double* x, double* result, size_t size) {
+		apply(x, result, size, exp8);
+	}
+
+	void log(const double* x, double* result, size_t size) {
+		apply(x, result, size, log8);
+	}
+
+	void abs(const double* x, double* result, size_t size) {
+		apply(x, result, size, [](const __m512d v) { return _mm512_abs_pd(v); });
+	}
+
+	void polynomial(const double* x, const double* coefficients, size_t degree, double* result, size_t size) {
+		apply(x, result, size, [=](const __m512d v) {
+			__m512d p = _mm512_set1_pd(coefficients[0]);
+			for (size_t j = 1; j <= degree; ++j) {
+				p = _mm512_fmadd_pd(p, v, _mm512_set1_pd(coefficients[j]));
+			}
+			return p;
+		});
+	}
+
+	const VectorMath::Kernels kernels = { "avx512", exp, log, abs, polynomial };
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+const VectorMath::Kernels* VectorMath::avx512() {
+	return CpuFeatures::avx512f() ? &kernels : nullptr;
+}
+#else
+const VectorMath::Kernels* VectorMath::avx512() {
+	return nullptr;
+}
+#endif
\ No newline at end of file
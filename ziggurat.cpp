@@ -0,0 +1,80 @@
+#include "ziggurat.h"
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+namespace {
+	const int layers = 256;
+	// Start of the tail and area of each layer for 256 layers.
+	const double tail = 7.697117470131487;
+	const double area = 3.949659822581572e-3;
+	// Random values are the 53 high bits of a word; the low 8 bits select the layer, bit 8 the sign.
+	const double scale = 9007199254740992.0;
+
+	struct Tables {
+		uint64_t k[layers];
+		double w[layers];
+		double f[layers];
+
+		Tables() {
+			double d = tail, t = tail;
+			double q = area / exp(-d);
+			k[0] = (uint64_t)(d / q * scale);
+			k[1] = 0;
+			w[0] = q / scale;
+			w[layers - 1] = d / scale;
+			f[0] = 1;
+			f[layers - 1] = exp(-d);
+			for (int i = layers - 2; i >= 1; --i) {
+				d = -log(area / d + exp(-d));
+				k[i + 1] = (uint64_t)(d / t * scale);
+				t = d;
+				f[i] = exp(-d);
+				w[i] = d / scale;
+			}
+		}
+	};
+
+	const Tables tables;
+
+	std::mt19937_64& engine() {
+		thread_local std::mt19937_64 instance(((uint64_t)rand() << 32) ^ (uint64_t)rand());
+		return instance;
+	}
+}
+
+uint64_t ZigguratExponential::random_bits() {
+	return engine()();
+}
+
+double ZigguratExponential::uniform() {
+	return ((random_bits() >> 11) + 0.5) / scale;
+}
+
+double ZigguratExponential::sample(uint64_t bits) {
+	for (;;) {
+		const int i = bits & (layers - 1);
+		const uint64_t j = bits >> 11;
+		if (j < tables.k[i]) {
+			return j * tables.w[i];
+		}
+		if (i == 0) {
+			return tail - log(uniform());
+		}
+		const double x = j * tables.w[i];
+		if (tables.f[i] + uniform() * (tables.f[i - 1] - tables.f[i]) < exp(-x)) {
+			return x;
+		}
+		bits = random_bits();
+	}
+}
+
+double ZigguratExponential::sample() {
+	return sample(random_bits());
+}
+
+double ZigguratExponential::signed_sample() {
+	const uint64_t bits = random_bits();
+	const double x = sample(bits);
+	return bits & layers ? -x : x;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+// Marsaglia-Tsang ziggurat for the standard exponential distribution with
+// 256 layers. About 99% of draws take one 64-bit random word, a table lookup
+// and a multiplication; log and exp are only evaluated in the rare wedge and
+// tail cases. Each thread owns a 64-bit Mersenne Twister seeded from rand()
+// on its first draw, so srand() still makes a run reproducible.
+class ZigguratExponential {
+public:
+	static double sample();
+	// Exponential variate with a random sign: a standard Laplace (n = 1) variate.
+	static double signed_sample();
+private:
+	static double sample(uint64_t bits);
+	static uint64_t random_bits();
+	static double uniform();
+};
\ No newline at end of file